@@ -1,46 +1,87 @@
 #include "Algorithm.h"
 #include "EntryExit.h"
+#include "FactoredModel.h"
+#include "FeatureRegistry.h"
+#include "SequenceEvaluator.h"
 
 using namespace std;
 
 unique_ptr<Algorithm> Algorithm::bestAlgorithm() {
+    // fixed pool size, as the training pools of Learner: an adaptive pool
+    // (EntryExit chunk>0) changes the pool-level route features
     return unique_ptr<Algorithm>(new EntryExit(5000, 1.25, 1.25, false));
 }
 
-bool Algorithm::better(const Sequence& s1, const Sequence& s2) {
-    if (s1.nanoSimilarity()<0 || s1.nanoTransitions()<=0
-            || s2.nanoSimilarity()<0 || s2.nanoTransitions()<=0)
+bool Algorithm::better(const SequencePool& pool, size_t i, size_t j) {
+    if (pool.nanoSimilarity(i)<0 || pool.nanoTransitions(i)<=0
+            || pool.nanoSimilarity(j)<0 || pool.nanoTransitions(j)<=0)
         cout<<"warning: invalid sequence similarity and/or transitions"<<endl;
-    return (1.0*s1.nanoSimilarity())/s1.nanoTransitions()
-         > (1.0*s2.nanoSimilarity())/s2.nanoTransitions();
+    return pool.simByTransNano(i) > pool.simByTransNano(j);
+}
+
+// rows not evaluated yet (e.g. all but those of earlier chunks)
+void Algorithm::evaluate(SequencePool& pool, const RoutingPattern& patt) {
+    const auto& rows=pool.rows();
+    #pragma omp parallel
+    {
+        SequenceEvaluator ev(pool.route(), patt);
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t k=0; k<rows.size(); ++k)
+            if (pool.nanoSimilarity(rows[k])<0)
+                pool.evaluate(rows[k], ev);
+    }
+}
+
+// keeps the rows within 0.925 of the best nano similarity by transitions and
+// scores them with the evaluation model: returns the best predicted score
+double Algorithm::predict(const Route& r, const SequencePool& pool,
+        const Model& model, size_t& best) {
+    const auto bypool=[&pool](size_t i, size_t j){return better(pool, i, j);};
+    const auto& all=pool.rows();
+    const auto stats=pool.statistics();
+    const auto p_best=*min_element(all.begin(), all.end(), bypool);
+    const double max_sbtnano=pool.simByTransNano(p_best);
+    vector<size_t> rows;
+    rows.reserve(all.size());
+    for (const auto i : all)
+        if (pool.simByTransNano(i)>=0.925*max_sbtnano)
+            rows.push_back(i);
+    const auto& evlmodel=model.evaluationModel();
+    // route interactions are folded into one weight per sequence feature
+    FactoredModel fm(evlmodel, r.station());
+    vector<double> rt(FeatureRegistry::RT_N);
+    FeatureRegistry::routeFeatures(r, stats, rt.data());
+    fm.setRoute(stats, rt.data());
+    // all surviving sequences as columns, scored by one matrix product
+    vector<double> S(FeatureRegistry::SQ_N*rows.size());
+    FeatureRegistry::sequenceFeatures(pool, rows, stats, rt.data(), S.data());
+    vector<double> pscores(rows.size(), 0);
+    fm.predict(S.data(), rows.size(), pscores.data());
+    auto idxbest=min_element(pscores.begin(),pscores.end())-pscores.begin();
+    best=rows[idxbest];
+    return pscores[idxbest];
 }
 
 Sequence Algorithm::selectSequence(const Route& r, const Algorithm& alg,
         const Model& model) {
     cout<<r.id()<<" ;  station: "<<r.station()<<endl;
-    auto pool=alg.findSequences(r, model.algoInput());
-    for (auto& seq : pool)
-        r.setupSimilarity(seq, model.algoInput().pattern());
+    Predictor predictor;
+    if (model.hasEvaluationModel())
+        predictor=[&r, &model](const SequencePool& pool) {
+            size_t best;
+            return predict(r, pool, model, best);
+        };
+    auto pool=alg.findSequences(r, model.algoInput(), predictor);
+    evaluate(pool, model.algoInput().pattern());
     if (model.hasEvaluationModel()) {
-        const auto stats=Sequence::statistics(pool);
-        const auto p_seq=min_element(pool.begin(), pool.end(), better);
-        const double max_sbtnano=(1.0*p_seq->nanoSimilarity())
-                /p_seq->nanoTransitions();
-        pool.erase(remove_if(pool.begin(), pool.end(), [&](const Sequence& s){
-            return (1.0*s.nanoSimilarity())
-                    /s.nanoTransitions()<0.925*max_sbtnano;
-            }), pool.end());
-        const auto& evlmodel=model.evaluationModel();
-        // some manoeuvre to call only pool.size() times 'predict'
-        vector<double> pscores(pool.size(), 0);
-        for (size_t i=0; i<pool.size(); ++i)
-            pscores[i]=evlmodel.predict(pool[i].features(r, stats));
-        auto idxbest=min_element(pscores.begin(),pscores.end())-pscores.begin();
-        cout<<"predicted score: "<<pscores[idxbest]<<endl;
-        return pool[idxbest];
+        size_t best;
+        cout<<"predicted score: "<<predict(r, pool, model, best)<<endl;
+        return pool.sequence(best);
     } else {
+        const auto bypool=[&pool](size_t i, size_t j)
+                {return better(pool, i, j);};
+        const auto& rows=pool.rows();
         cout<<"warning: evaluation model not available"<<endl;
-        return *min_element(pool.begin(), pool.end(), better);
+        return pool.sequence(*min_element(rows.begin(), rows.end(), bypool));
     }
 }
-
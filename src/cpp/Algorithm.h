@@ -1,25 +1,42 @@
 #ifndef algorithm_h
 #define algorithm_h
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 #include "AlgoInput.h"
 #include "Model.h"
 #include "Sequence.h"
+#include "SequencePool.h"
 
 class Algorithm {
     protected:
         std::string id_;
     public:
+        // predicted score of the sequence selectSequence would pick from an
+        // evaluated pool
+        typedef std::function<double(const SequencePool&)> Predictor;
         static std::unique_ptr<Algorithm> bestAlgorithm();
-        static bool better(const Sequence& s1, const Sequence& s2);
+        static bool better(const SequencePool& pool, size_t i, size_t j);
+        // evaluates the rows that weren't evaluated yet
+        static void evaluate(SequencePool& pool, const RoutingPattern& patt);
         const std::string& id() const {return id_;}
-        virtual std::vector<Sequence> findSequences(const Route& r,
+        virtual SequencePool findSequences(const Route& r,
                 const AlgoInput& input) const=0;
-        virtual std::vector<Sequence> findSequences(size_t n, const Route& r,
+        virtual SequencePool findSequences(size_t n, const Route& r,
                 const AlgoInput& input) const=0;
+        // algorithms building their pool in chunks may stop early using
+        // 'predict' (empty without evaluation model); others ignore it
+        virtual SequencePool findSequences(const Route& r,
+                const AlgoInput& input, const Predictor& predict) const {
+            return findSequences(r, input);
+        }
         static std::vector<std::shared_ptr<Algorithm>> pool(bool training);
+        // scores the rows kept by the filter of selectSequence; best: row of
+        // the best score
+        static double predict(const Route& r, const SequencePool& pool,
+                const Model& model, size_t& best);
         virtual bool randomized() const=0;
         static Sequence selectMySequence(const Route& r, const Algorithm& alg,
                 const Model& model);
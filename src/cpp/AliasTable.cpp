@@ -0,0 +1,35 @@
+#include <numeric>
+#include "AliasTable.h"
+
+using namespace std;
+
+AliasTable::AliasTable(const vector<double>& weights) {
+    const double sum=accumulate(weights.begin(), weights.end(), 0.0);
+    if (sum<=0)
+        return;
+    const size_t n=weights.size();
+    prob.resize(n);
+    alias.resize(n);
+    // scaled weights: below 1 (small) columns are topped up by large ones
+    vector<size_t> small, large;
+    for (size_t i=0; i<n; ++i) {
+        prob[i]=weights[i]*n/sum;
+        alias[i]=i;
+        (prob[i]<1 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        const size_t s=small.back(), l=large.back();
+        small.pop_back();
+        alias[s]=l;
+        prob[l]-=1-prob[s];
+        if (prob[l]<1) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // left over columns are full (up to rounding)
+    for (const auto i : large)
+        prob[i]=1;
+    for (const auto i : small)
+        prob[i]=1;
+}
@@ -0,0 +1,26 @@
+#ifndef aliastable_h
+#define aliastable_h
+
+#include <random>
+#include <vector>
+
+// samples index i with probability weights[i]/sum(weights) in O(1) (Walker's
+// alias method, built in O(n) with Vose's worklists); a table without
+// positive weight is empty
+class AliasTable {
+    private:
+        std::vector<double> prob;       // keep i, otherwise take alias[i]
+        std::vector<size_t> alias;
+    public:
+        AliasTable(const std::vector<double>& weights);
+        bool empty() const {return prob.empty();}
+        template<class URBG> size_t operator()(URBG& g) const {
+            const size_t i=std::uniform_int_distribution<size_t>(0,
+                    prob.size()-1)(g);
+            return std::uniform_real_distribution<double>(0, 1)(g)<prob[i]
+                    ? i : alias[i];
+        }
+        size_t size() const {return prob.size();}
+};
+
+#endif
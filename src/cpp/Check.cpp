@@ -0,0 +1,938 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <random>
+#include <string>
+#include <vector>
+#include "AliasTable.h"
+#include "DenseRoute.h"
+#include "HeldKarp.h"
+#include "LocalSearch.h"
+#include "Random.h"
+#include "RoutingPattern.h"
+#include "Sequence.h"
+#include "SequenceBuilder.h"
+#include "SequenceEvaluator.h"
+#include "SequencePool.h"
+#include "TSPHeuristic.h"
+#include "TestRoute.h"
+#include "TimingEvaluator.h"
+#include "TimingSummary.h"
+#include "TTMatrix.h"
+
+using namespace std;
+
+// repeatable checks of the optimized kernels against plain references, on
+// synthetic data with fixed seeds (make check); no model or input files
+
+static size_t failures=0;
+
+static void expect(bool ok, const string& what) {
+    if (!ok) {
+        cout<<"FAILED: "<<what<<endl;
+        failures++;
+    }
+}
+
+// n stops "0".."n-1" with travel times rounded to 10 s (ties are common)
+static TTMatrix randomMatrix(size_t n, mt19937& g) {
+    uniform_int_distribution<int> tt(1, 60);
+    TTMatrix m(n);
+    for (size_t i=0; i<n; ++i)
+        for (size_t j=0; j<n; ++j)
+            m.setTravelTime(to_string(i), to_string(j), i==j ? 0 : 10*tt(g));
+    return m;
+}
+
+// departure at 8:00 plus t seconds (t < 16 h)
+static string clockTime(long t) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "2021-07-15 %02ld:%02ld:%02ld", 8+t/3600,
+            t/60%60, t%60);
+    return buf;
+}
+
+// station "S" and stops "0".."n-2" in a unit square of about 3000 s across
+// (asymmetric travel times, or all equal to flat if it is positive), 2 x 3 x 4
+// zones; a share ptw of the stops has a time window within the first 4 hours
+static TestRoute syntheticRoute(size_t n, unsigned seed, double ptw,
+        double flat=0) {
+    mt19937 g(seed);
+    uniform_real_distribution<double> u(0, 1);
+    TestRoute r("check-"+to_string(seed));
+    r.setStation("S");
+    r.setDeparture(clockTime(0));
+    vector<string> ids;
+    vector<pair<double, double>> xy;
+    for (size_t i=0; i<n; ++i) {
+        ids.push_back(i==0 ? "S" : to_string(i-1));
+        xy.push_back({u(g), u(g)});
+        r.addStop(ids[i]);
+        auto& stop=r.getStop(ids[i]);
+        stop.setType(i==0 ? "Station" : "Dropoff");
+        stop.setLatLon(34+xy[i].second*0.1, -118+xy[i].first*0.1);
+        if (i==0)
+            continue;
+        stop.setNanoZone("S:"+string(1, 'A'+int(xy[i].first*2))+"-"
+                +to_string(int(xy[i].second*3))+"."+to_string(int(u(g)*4))
+                +"A");
+        Package pack("P"+ids[i], "UNDEFINED");
+        if (u(g)<ptw) {
+            const long start=u(g)*4*3600, end=start+1800+u(g)*3*3600;
+            pack.setTimeWindow(clockTime(start), clockTime(end));
+        }
+        pack.setServiceTime(20+u(g)*60);
+        stop.addPackage(move(pack));
+    }
+    TTMatrix tt(n);
+    for (size_t i=0; i<n; ++i)
+        for (size_t j=0; j<n; ++j) {
+            const double dx=xy[i].first-xy[j].first;
+            const double dy=xy[i].second-xy[j].second;
+            const double t=30+3000*sqrt(dx*dx+dy*dy)*(0.9+0.2*u(g));
+            tt.setTravelTime(ids[i], ids[j], i==j ? 0 : flat>0 ? flat : t);
+        }
+    r.setTravelTimes(move(tt));
+    r.setupRectangle();
+    return r;
+}
+
+static TimingEvaluator::Timing timingOf(const Sequence& seq) {
+    TimingEvaluator::Timing t;
+    t.duration=seq.duration();
+    t.earliness=seq.earliness();
+    t.lateness=seq.lateness();
+    t.max_earliness=seq.maxEarliness();
+    t.max_lateness=seq.maxLateness();
+    t.miss_early=seq.earlyArrivals();
+    t.miss_late=seq.lateArrivals();
+    return t;
+}
+
+static bool sameTiming(const TimingEvaluator::Timing& a,
+        const TimingEvaluator::Timing& b) {
+    return fabs(a.duration-b.duration)<=1e-6*max(1.0, b.duration)
+            && a.earliness==b.earliness && a.lateness==b.lateness
+            && a.max_earliness==b.max_earliness
+            && a.max_lateness==b.max_lateness && a.miss_early==b.miss_early
+            && a.miss_late==b.miss_late;
+}
+
+static Sequence toSequence(const DenseRoute& dr, const vector<size_t>& tour) {
+    vector<string> stops;
+    for (const auto s : tour)
+        stops.push_back(dr.id(s));
+    return Sequence(stops);
+}
+
+// sampled frequencies within 5 standard deviations of the weights (zero
+// weights never drawn); tables without positive weight are empty
+static void checkAliasTable() {
+    expect(AliasTable({}).empty() && AliasTable({0, 0}).empty(),
+            "alias table without weight");
+    const vector<vector<double>> cases={{3}, {1, 1}, {0, 2, 0, 1},
+            {0.001, 5, 1, 0, 20, 3.5, 0.25}, vector<double>(50, 1)};
+    Random::Stream g(50);
+    for (size_t c=0; c<cases.size(); ++c) {
+        const auto& w=cases[c];
+        const AliasTable t(w);
+        const double total=accumulate(w.begin(), w.end(), 0.0);
+        const size_t draws=200000;
+        vector<size_t> count(w.size(), 0);
+        for (size_t k=0; k<draws; ++k)
+            count[t(g)]++;
+        for (size_t i=0; i<w.size(); ++i) {
+            const double p=w[i]/total;
+            const double sd=sqrt(draws*p*(1-p));
+            expect(t.size()==w.size() && (w[i]>0 || count[i]==0)
+                    && fabs(count[i]-draws*p)<=5*sd+1e-9, "alias table "
+                    +to_string(c)+", index "+to_string(i));
+        }
+    }
+}
+
+// ERP per edit by the full (na+1) x (ns+1) table of the original recursion
+static double erpReference(const vector<size_t>& actual,
+        const vector<size_t>& sub, const TTMatrix& ttimes, const double g) {
+    const size_t na=actual.size(), ns=sub.size();
+    vector<vector<double>> d(na+1, vector<double>(ns+1));
+    vector<vector<size_t>> c(na+1, vector<size_t>(ns+1));
+    for (size_t i=na+1; i-->0;)
+        for (size_t j=ns+1; j-->0;) {
+            if (i==na || j==ns) {
+                c[i][j]=na-i+ns-j;
+                d[i][j]=c[i][j]*g;
+                continue;
+            }
+            const double optA=d[i+1][j+1]+ttimes.travelTime(actual[i], sub[j]);
+            const double optB=d[i+1][j]+g;
+            const double optC=d[i][j+1]+g;
+            if (optA<=optB && optA<=optC) {
+                d[i][j]=optA;
+                c[i][j]=c[i+1][j+1]+(actual[i]==sub[j] ? 0 : 1);
+            } else if (optB<=optC) {
+                d[i][j]=optB;
+                c[i][j]=c[i+1][j]+1;
+            } else {
+                d[i][j]=optC;
+                c[i][j]=c[i][j+1]+1;
+            }
+        }
+    return c[0][0]==0 ? 0 : d[0][0]/c[0][0];
+}
+
+// rolling rows and the AVX2 wavefront (used from 8 stops on) against the full
+// table; with a cutoff, a bounded result must not exceed the exact one
+static void checkErp() {
+    mt19937 g(35);
+    const TTMatrix tt=randomMatrix(60, g);
+    const double inf=numeric_limits<double>::infinity();
+    for (size_t trial=0; trial<300; ++trial) {
+        const size_t na=trial%41, ns=na+(trial%3==0 ? trial%7 : 0);
+        vector<size_t> stops(60);
+        iota(stops.begin(), stops.end(), 0);
+        shuffle(stops.begin(), stops.end(), g);
+        vector<size_t> actual(stops.begin(), stops.begin()+na);
+        vector<size_t> sub(stops.begin(), stops.begin()+ns);
+        // mostly a perturbed copy of actual, as a proposed sequence
+        shuffle(sub.begin(), sub.begin()+min<size_t>(ns, 3), g);
+        if (ns>1)
+            swap(sub[g()%ns], sub[g()%ns]);
+        const double gap=trial%2==0 ? 1000 : 200;
+        const double ref=erpReference(actual, sub, tt, gap);
+        bool bounded=false;
+        const double rows=Sequence::erpPerEdit(actual, sub, tt, gap, inf,
+                bounded);
+        const double fast=Sequence::erpPerEdit(actual, sub, tt, gap);
+        const string what="erp na="+to_string(na)+" ns="+to_string(ns);
+        expect(!bounded && fabs(rows-ref)<=1e-9*max(1.0, ref),
+                what+" (rows)");
+        expect(fast==rows, what+" (wavefront)");
+        for (const double f : {0.5, 0.9, 1.0, 1.1}) {
+            const double cutoff=f*ref;
+            const double r=Sequence::erpPerEdit(actual, sub, tt, gap, cutoff,
+                    bounded);
+            if (bounded)
+                expect(r>=cutoff && r<=ref*(1+1e-9), what+" (cutoff bound)");
+            else
+                expect(fabs(r-ref)<=1e-9*max(1.0, ref), what+" (cutoff)");
+        }
+    }
+}
+
+static vector<vector<size_t>> poolTours(const SequencePool& pool) {
+    vector<vector<size_t>> tours;
+    for (const auto i : pool.rows())
+        tours.emplace_back(pool.tour(i), pool.tour(i)+pool.route().size());
+    return tours;
+}
+
+// entry/exit pools (random and time window insertion) built with 1 thread
+// must be the same with more threads and when built in chunks
+static void checkPoolDeterminism() {
+    const auto r=syntheticRoute(60, 41, 0.3);
+    Random::setSeed(41);
+#ifdef _OPENMP
+    const int maxthreads=omp_get_max_threads();
+#endif
+    vector<pair<string, string>> combis;
+    for (size_t i=0; i<120; ++i)
+        combis.push_back({to_string(i%59), to_string((i*7+3)%59)});
+    combis.erase(remove_if(combis.begin(), combis.end(),
+            [](const pair<string, string>& p) {return p.first==p.second;}),
+            combis.end());
+    for (const auto ins : {TSPHeuristic::Insertion::random,
+            TSPHeuristic::Insertion::timeWindows}) {
+        const string what=string("pool determinism (")
+                +(ins==TSPHeuristic::Insertion::random ? "random"
+                : "time windows")+" insertion)";
+        vector<vector<size_t>> serial;
+        for (const int threads : {1, 2, 3, 8}) {
+#ifdef _OPENMP
+            omp_set_num_threads(threads);
+#endif
+            const auto pool=SequenceBuilder::buildRandom(r, combis, 1, 1,
+                    ins);
+            if (threads==1)
+                serial=poolTours(pool);
+            else
+                expect(poolTours(pool)==serial, what+", "
+                        +to_string(threads)+" threads");
+        }
+        // chunks of 50 pairs (the pair number gives the stream)
+        SequencePool pool(r);
+        for (size_t first=0; first<combis.size(); first+=50) {
+            const vector<pair<string, string>> chunk(combis.begin()+first,
+                    combis.begin()+min(first+50, combis.size()));
+            SequenceBuilder::addRandom(pool, r, chunk, first, 1, 1, ins);
+        }
+        expect(serial.size()>1 && poolTours(pool)==serial, what+", chunks");
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(maxthreads);
+#endif
+}
+
+// single-pass metrics against Route::setupTiming and Route::setupSimilarity
+// on random tours; some dropoffs have no zone (ignored by the similarity, id 0
+// at all levels) or no macro zone (id 0 at that level only), and some tours
+// end with dropoffs without zone before the closing pair
+static void checkSequenceEvaluator() {
+    auto r=syntheticRoute(40, 29, 0.5);
+    mt19937 g(29);
+    vector<string> ids;
+    for (size_t i=0; i<39; ++i) {
+        ids.push_back(to_string(i));
+        auto& stop=r.getStop(ids.back());
+        if (i%7==0)
+            stop.setNanoZone("");
+        else if (i%11==0)
+            stop.setNanoZone("-"+to_string(i%2)+".1A");
+    }
+    // pattern counts from random tours (including zone "" and the station)
+    RoutingPattern patt;
+    for (size_t k=0; k<30; ++k) {
+        shuffle(ids.begin(), ids.end(), g);
+        for (size_t i=0; i<=ids.size(); ++i) {
+            const auto& a=r.getStop(i==0 ? r.station() : ids[i-1]);
+            const auto& b=r.getStop(i==ids.size() ? r.station() : ids[i]);
+            patt.addMacro(r.station(), a.macroZone(), b.macroZone());
+            patt.addMicro(r.station(), a.microZone(), b.microZone());
+            patt.addNano(r.station(), a.nanoZone(), b.nanoZone());
+        }
+    }
+    const DenseRoute dr(r);
+    SequenceEvaluator ev(dr, patt);
+    SequenceEvaluator::Metrics m;
+    for (size_t trial=0; trial<200; ++trial) {
+        shuffle(ids.begin(), ids.end(), g);
+        if (trial%4==0)     // dropoffs without zone last
+            stable_partition(ids.begin(), ids.end(), [&r](const string& s)
+                    {return r.getStop(s).nanoZone()!="";});
+        vector<size_t> tour(1, dr.station());
+        for (const auto& s : ids)
+            tour.push_back(dr.index(s));
+        ev.evaluate(tour.data(), m);
+        auto seq=toSequence(dr, tour);
+        r.setupTiming(seq);
+        r.setupSimilarity(seq, patt);
+        const string what="sequence evaluator, trial "+to_string(trial);
+        expect(sameTiming(m.timing, timingOf(seq)), what+" (timing)");
+        expect(m.sim_macro==seq.macroSimilarity()
+                && m.sim_micro==seq.microSimilarity()
+                && m.sim_nano==seq.nanoSimilarity(), what+" (similarity)");
+        expect(m.trans_macro==seq.macroTransitions()
+                && m.trans_micro==seq.microTransitions()
+                && m.trans_nano==seq.nanoTransitions(),
+                what+" (transitions)");
+    }
+}
+
+// relocate, swap and 2-opt queries against a fresh evaluator and
+// Route::setupTiming on the moved tour; every other move is applied and the
+// updated evaluator checked the same way (timing() and per stop); with equal
+// travel times the tail after a move is back in sync
+static void checkTimingEvaluator() {
+    for (const double flat : {0, 300}) {
+        const auto r=syntheticRoute(50, 26, 0.8, flat);
+        const DenseRoute dr(r);
+        const size_t n=dr.size();
+        mt19937 g(26);
+        vector<size_t> tour(1, dr.station());
+        for (size_t i=0; i<n; ++i)
+            if (i!=dr.station())
+                tour.push_back(i);
+        shuffle(tour.begin()+1, tour.end(), g);
+        TimingEvaluator ev(dr, tour);
+        for (size_t trial=0; trial<600; ++trial) {
+            size_t i=1+g()%(n-1), j=1+g()%(n-1);
+            auto moved=ev.tour();
+            TimingEvaluator::Timing t;
+            string what;
+            if (trial%3==0) {
+                const size_t s=moved[i];
+                moved.erase(moved.begin()+i);
+                moved.insert(moved.begin()+j, s);
+                t=ev.evaluateRelocate(i, j);
+                what="relocate";
+            } else if (trial%3==1) {
+                swap(moved[i], moved[j]);
+                t=ev.evaluateSwap(i, j);
+                what="swap";
+            } else {
+                if (i==j)
+                    j=i<n-1 ? i+1 : i-1;
+                if (j<i)
+                    swap(i, j);
+                reverse(moved.begin()+i, moved.begin()+j+1);
+                t=ev.evaluateTwoOpt(i, j);
+                what="2-opt";
+            }
+            what+=" "+to_string(i)+", "+to_string(j)+" (flat="
+                    +to_string(int(flat))+", trial "+to_string(trial)+")";
+            auto seq=toSequence(dr, moved);
+            r.setupTiming(seq);
+            const TimingEvaluator fresh(dr, moved);
+            expect(sameTiming(t, fresh.timing()), what+" (evaluator)");
+            expect(sameTiming(t, timingOf(seq)), what+" (route)");
+            if (trial%2==1)
+                continue;
+            if (trial%3==0)
+                ev.applyRelocate(i, j);
+            else if (trial%3==1)
+                ev.applySwap(i, j);
+            else
+                ev.applyTwoOpt(i, j);
+            auto applied=toSequence(dr, ev.tour());
+            ev.setupTiming(applied);
+            bool stops=ev.tour()==moved;
+            for (size_t p=0; p<n && stops; ++p)
+                stops=applied.earliness(p)==seq.earliness(p)
+                        && applied.lateness(p)==seq.lateness(p);
+            expect(stops && sameTiming(ev.timing(), timingOf(seq)),
+                    what+" (applied)");
+        }
+    }
+}
+
+// random insertion from a guide: pending nodes in the order of the solver's
+// shuffle, each inserted before the first position of strictly smallest cost
+// (position 0: between the last and the first node); with 'fix' the arcs
+// leaving the last node and the first one are kept
+static vector<size_t> insertionReference(const vector<vector<double>>& c,
+        const vector<size_t>& guide, bool fix, Random::Stream g) {
+    vector<size_t> tour=guide, pending;
+    for (size_t v=0; v<c.size(); ++v)
+        if (find(guide.begin(), guide.end(), v)==guide.end())
+            pending.push_back(v);
+    shuffle(pending.begin(), pending.end(), g);
+    while (!pending.empty()) {
+        const size_t r=pending.back();
+        pending.pop_back();
+        size_t bestpos=tour.size();
+        double bestcost=numeric_limits<double>::max();
+        for (size_t p=fix ? 2 : 0; p<tour.size(); ++p) {
+            const size_t a=p==0 ? tour.back() : tour[p-1], b=tour[p];
+            if (c[a][r]+c[r][b]-c[a][b]<bestcost) {
+                bestpos=p;
+                bestcost=c[a][r]+c[r][b]-c[a][b];
+            }
+        }
+        tour.insert(tour.begin()+bestpos, r);
+    }
+    return tour;
+}
+
+// TSPHeuristic::randomInsertion with a guide (scalar and AVX2 position
+// search) against the reference, on costs with many ties; the solver is
+// reused across instances of the same size
+static void checkInsertion() {
+    mt19937 g(40);
+    for (const size_t n : {3, 4, 7, 12, 33, 80}) {
+        uniform_int_distribution<int> cost(1, 4);
+        vector<vector<double>> c(n, vector<double>(n, 0));
+        for (size_t i=0; i<n; ++i)
+            for (size_t j=0; j<n; ++j)
+                if (i!=j)
+                    c[i][j]=cost(g);
+        TSPHeuristic tsp(c, Random::Stream(0));
+        for (size_t trial=0; trial<40; ++trial) {
+            vector<size_t> nodes(n);
+            iota(nodes.begin(), nodes.end(), 0);
+            shuffle(nodes.begin(), nodes.end(), g);
+            const vector<size_t> guide(nodes.begin(), nodes.begin()
+                    +min<size_t>(n, 2+trial%2));
+            const bool fix=trial%4<2;
+            tsp.setStream(Random::Stream(trial));
+            const auto sol=tsp.randomInsertion(guide, fix);
+            const auto ref=insertionReference(c, guide, fix,
+                    Random::Stream(trial));
+            const string what="insertion n="+to_string(n)+" trial "
+                    +to_string(trial);
+            expect(sol.tour()==ref, what+" (tour)");
+            double total=0;
+            for (size_t p=0; p<ref.size(); ++p)
+                total+=c[ref[p]][ref[(p+1)%ref.size()]];
+            expect(fabs(sol.value()-total)<1e-9, what+" (value)");
+            if (fix && guide.size()==3 && n>3)
+                expect(ref[0]==guide[0] && ref[1]==guide[1]
+                        && ref.back()==guide[2], what+" (fixed arcs)");
+        }
+    }
+}
+
+// cheapest/farthest insertion by full scans: the cheapest (pending node,
+// position) pair, or the pending node farthest from the tour (minimum cost to
+// a tour node, first in index order) at its cheapest position; with 'fix' the
+// arcs leaving the first node and entering it are kept, unless no other arc
+// is left (the arc into the first node is split); the tour keeps its first node
+static vector<size_t> constructionReference(const vector<vector<double>>& c,
+        const vector<size_t>& guide, bool fix, bool farthest) {
+    const size_t n=c.size();
+    vector<size_t> tour=guide, pending;
+    if (tour.empty()) {     // cheapest/farthest arc
+        tour={0, 1};
+        for (size_t i=0; i<n; ++i)
+            for (size_t j=0; j<n; ++j)
+                if (i!=j && (farthest ? c[i][j]>c[tour[0]][tour[1]]
+                        : c[i][j]<c[tour[0]][tour[1]]))
+                    tour={i, j};
+        fix=false;
+    }
+    for (size_t v=0; v<n; ++v)
+        if (find(tour.begin(), tour.end(), v)==tour.end())
+            pending.push_back(v);
+    // inserting v before position p (p=size: between the last and the first)
+    const auto position=[&](size_t v, double& bestcost) {
+        const auto icost=[&](size_t p) {
+            const size_t a=tour[p-1], b=tour[p%tour.size()];
+            return c[a][v]+c[v][b]-c[a][b];
+        };
+        size_t bestpos=tour.size();
+        bestcost=numeric_limits<double>::max();
+        for (size_t p=fix ? 2 : 1; p<=tour.size()-(fix ? 1 : 0); ++p)
+            if (icost(p)<bestcost) {
+                bestpos=p;
+                bestcost=icost(p);
+            }
+        if (bestcost==numeric_limits<double>::max())
+            bestcost=icost(bestpos);
+        return bestpos;
+    };
+    while (!pending.empty()) {
+        size_t k=0, bestpos=0;
+        double bestcost;
+        if (farthest) {
+            vector<double> dist(pending.size(), numeric_limits<double>::max());
+            for (size_t q=0; q<pending.size(); ++q)
+                for (const auto u : tour)
+                    dist[q]=min(dist[q], c[pending[q]][u]);
+            k=max_element(dist.begin(), dist.end())-dist.begin();
+            bestpos=position(pending[k], bestcost);
+        } else {
+            bestcost=numeric_limits<double>::max();
+            for (size_t q=0; q<pending.size(); ++q) {
+                double cq;
+                const size_t p=position(pending[q], cq);
+                if (cq<bestcost) {
+                    k=q;
+                    bestpos=p;
+                    bestcost=cq;
+                }
+            }
+        }
+        tour.insert(tour.begin()+bestpos, pending[k]);
+        pending.erase(pending.begin()+k);
+    }
+    return tour;
+}
+
+// TSPHeuristic cheapest and farthest insertion against the full scans, on
+// costs without ties, from no guide and from 2- and 3-node guides
+static void checkConstruction() {
+    mt19937 g(45);
+    uniform_real_distribution<double> cost(1, 100);
+    for (const size_t n : {3, 4, 6, 15, 40}) {
+        for (size_t trial=0; trial<30; ++trial) {
+            vector<vector<double>> c(n, vector<double>(n, 0));
+            for (size_t i=0; i<n; ++i)
+                for (size_t j=0; j<n; ++j)
+                    if (i!=j)
+                        c[i][j]=cost(g);
+            TSPHeuristic tsp(c, Random::Stream(0));
+            vector<size_t> nodes(n);
+            iota(nodes.begin(), nodes.end(), 0);
+            shuffle(nodes.begin(), nodes.end(), g);
+            const vector<size_t> guide(nodes.begin(), nodes.begin()
+                    +min<size_t>(n, trial%3==0 ? 0 : 1+trial%3));
+            const bool fix=trial%2==0;
+            for (const bool farthest : {false, true}) {
+                const auto sol=tsp.insertion(farthest
+                        ? TSPHeuristic::Insertion::farthest
+                        : TSPHeuristic::Insertion::cheapest, guide, fix);
+                const auto ref=constructionReference(c, guide, fix, farthest);
+                const string what=string(farthest ? "farthest" : "cheapest")
+                        +" insertion n="+to_string(n)+" guide "
+                        +to_string(guide.size())+(fix ? " fixed" : "")
+                        +", trial "+to_string(trial);
+                expect(sol.tour()==ref, what+" (tour)");
+                double total=0;
+                for (size_t p=0; p<ref.size(); ++p)
+                    total+=c[ref[p]][ref[(p+1)%ref.size()]];
+                expect(fabs(sol.value()-total)<1e-9, what+" (value)");
+            }
+        }
+    }
+}
+
+// time window insertion from the station, entry and exit: the tour keeps
+// them and its value is its cost; the time window deltas of insertions into
+// partial tours against TimingEvaluator: the penalty of the inserted stop is
+// exact, the change of the later stops too if flagged, otherwise it has the
+// same sign and a smaller magnitude; both kinds must occur
+static void checkTimeWindowInsertion() {
+    const auto r=syntheticRoute(60, 46, 0.6);
+    const DenseRoute dr(r);
+    const size_t n=dr.size();
+    TSPHeuristic tsp(Random::Stream(46));
+    tsp.setCosts(n, [&dr](size_t i, size_t j) {return dr.travelTime(i, j);});
+    vector<size_t> dense(n);
+    iota(dense.begin(), dense.end(), 0);
+    tsp.setTimeWindows(dr, dense, 1);
+    mt19937 g(46);
+    vector<size_t> stops;
+    for (size_t i=0; i<n; ++i)
+        if (i!=dr.station())
+            stops.push_back(i);
+    for (size_t trial=0; trial<20; ++trial) {
+        shuffle(stops.begin(), stops.end(), g);
+        const bool fix=trial%2==0;
+        const vector<size_t> guide={dr.station(), stops[0], stops[1]};
+        tsp.setStream(Random::Stream(trial));
+        const auto sol=tsp.insertion(TSPHeuristic::Insertion::timeWindows,
+                guide, fix);
+        const auto& t=sol.tour();
+        double total=0;
+        for (size_t p=0; p<t.size(); ++p)
+            total+=dr.travelTime(t[p], t[(p+1)%t.size()]);
+        vector<size_t> all(1, dr.station());
+        all.insert(all.end(), stops.begin(), stops.end());
+        const string what="time window insertion, trial "+to_string(trial);
+        expect(t.size()==n && t[0]==dr.station() && (!fix || (t[1]==stops[0]
+                && t.back()==stops[1])) && is_permutation(t.begin(), t.end(),
+                all.begin()), what+" (stops)");
+        expect(fabs(sol.value()-total)<=1e-6, what+" (value)");
+    }
+    // sum of a per-stop metric over positions [from,to)
+    const auto sum=[](const vector<double>& v, size_t from, size_t to) {
+        return accumulate(v.begin()+from, v.begin()+to, 0.0);
+    };
+    size_t exact=0, inexact=0;
+    vector<double> e0(n), l0(n), e1(n), l1(n);
+    for (size_t trial=0; trial<2000; ++trial) {
+        shuffle(stops.begin(), stops.end(), g);
+        const size_t m=2+g()%(n-2);         // partial tour: station, m-1 stops
+        vector<size_t> partial(1, dr.station());
+        partial.insert(partial.end(), stops.begin(), stops.begin()+m-1);
+        const size_t v=stops[m-1], p=1+g()%m;
+        auto inserted=partial;
+        inserted.insert(inserted.begin()+p, v);
+        const auto d=tsp.timeWindowDelta(partial, v, p);
+        TimingEvaluator::timing(dr, partial.data(), m, e0.data(), l0.data());
+        TimingEvaluator::timing(dr, inserted.data(), m+1, e1.data(),
+                l1.data());
+        const double late=sum(l1, p+1, m+1)-sum(l0, p, m);
+        const double early=sum(e1, p+1, m+1)-sum(e0, p, m);
+        const string what="time window delta, trial "+to_string(trial);
+        expect(d.own==e1[p]+l1[p], what+" (inserted stop)");
+        const double changes[2][2]={{d.late, late}, {d.early, early}};
+        const bool flags[2]={d.exact_late, d.exact_early};
+        for (size_t k=0; k<2; ++k) {
+            const double est=changes[k][0], truth=changes[k][1];
+            if (flags[k]) {
+                exact++;
+                expect(est==truth, what+(k==0 ? " (lateness)"
+                        : " (earliness)"));
+            } else {
+                inexact++;
+                expect(est*truth>0 && fabs(est)<=fabs(truth), what
+                        +(k==0 ? " (lateness bound)" : " (earliness bound)"));
+            }
+        }
+    }
+    expect(exact>0 && inexact>0, "time window deltas: "+to_string(exact)
+            +" exact, "+to_string(inexact)+" bounds");
+}
+
+static double pathCost(const DenseRoute& dr, const vector<size_t>& path) {
+    double c=0;
+    for (size_t p=1; p<path.size(); ++p)
+        c+=dr.travelTime(path[p-1], path[p]);
+    return c;
+}
+
+// zone by zone tours on a route with dropoffs without zone (or without macro
+// zone): permutations from the station, the stops of each zone contiguous at
+// every level once the stops without zone are left out, and the same pool
+// again for the same seed
+static void checkHierarchical() {
+    auto r=syntheticRoute(120, 43, 0);
+    for (size_t i=0; i<119; ++i)
+        if (i%13==0)
+            r.getStop(to_string(i)).setNanoZone("");
+        else if (i%17==0)
+            r.getStop(to_string(i)).setNanoZone("-2.1A");
+    RoutingPattern patt;
+    Random::setSeed(43);
+    const auto pool=SequenceBuilder::buildHierarchical(r, 20, patt);
+    const auto again=SequenceBuilder::buildHierarchical(r, 20, patt);
+    const auto& dr=pool.route();
+    const size_t n=dr.size();
+    typedef DenseRoute::Level Level;
+    vector<size_t> all(n);
+    iota(all.begin(), all.end(), 0);
+    expect(pool.size()>1 && poolTours(pool)==poolTours(again),
+            "hierarchical tours (same seed)");
+    for (const auto& t : poolTours(pool)) {
+        expect(t[0]==dr.station() && is_permutation(t.begin(), t.end(),
+                all.begin()), "hierarchical tour (stops)");
+        for (const auto l : {Level::macro, Level::micro, Level::nano}) {
+            // a zone must not come back once left
+            vector<char> done(dr.zones(l), 0);
+            int curr=-1;
+            bool contiguous=true;
+            for (size_t p=1; p<n; ++p) {
+                if (dr.unknownZone(t[p]))
+                    continue;
+                const int z=dr.zone(l, t[p]);
+                if (z==curr)
+                    continue;
+                if (curr>=0)
+                    done[curr]=1;
+                contiguous=contiguous && !done[z];
+                curr=z;
+            }
+            expect(contiguous, "hierarchical tour (zones at level "
+                    +to_string(static_cast<int>(l))+")");
+        }
+    }
+}
+
+// Held-Karp paths (first and last stop fixed) against all permutations, and
+// the relocation fallback above the cap against the initial path
+static void checkHeldKarp() {
+    const auto r=syntheticRoute(40, 44, 0);
+    const DenseRoute dr(r);
+    mt19937 g(44);
+    HeldKarp hk(7);
+    for (size_t trial=0; trial<60; ++trial) {
+        const size_t m=2+trial%10;
+        vector<size_t> stops(dr.size());
+        iota(stops.begin(), stops.end(), 0);
+        shuffle(stops.begin(), stops.end(), g);
+        stops.resize(m);
+        const double before=pathCost(dr, stops);
+        double bestcost=numeric_limits<double>::max();
+        auto perm=stops;
+        sort(perm.begin()+1, perm.end()-1);
+        do
+            bestcost=min(bestcost, pathCost(dr, perm));
+        while (next_permutation(perm.begin()+1, perm.end()-1));
+        auto path=stops;
+        const bool improved=hk.optimize(dr, path.data(), m);
+        const double after=pathCost(dr, path);
+        const string what="held-karp m="+to_string(m)+" trial "
+                +to_string(trial);
+        auto sorted=path, expected=stops;
+        sort(sorted.begin(), sorted.end());
+        sort(expected.begin(), expected.end());
+        expect(sorted==expected && path[0]==stops[0]
+                && path[m-1]==stops[m-1], what+" (same stops and ends)");
+        expect(improved==(after<before-1e-9) && after<=before+1e-9,
+                what+" (improvement)");
+        if (m-2<=7)
+            expect(fabs(after-bestcost)<=1e-6, what+" (optimal)");
+    }
+}
+
+// 2-opt and Or-opt search on random tours: the station, entry and exit stay,
+// the cost doesn't increase (improved iff lower), no improving 2-opt or
+// relocate move is left among those the neighbour lists cover (new arc to one
+// of the k nearest successors/predecessors, shorter than the arc it
+// replaces), and the total is below the adjacent swaps of myOpt
+static void checkLocalSearch() {
+    const auto r=syntheticRoute(80, 42, 0);
+    const DenseRoute dr(r);
+    const size_t n=dr.size(), k=8;
+    LocalSearch ls(dr, k);
+    const auto c=[&dr](size_t i, size_t j) {return dr.travelTime(i, j);};
+    // k nearest successors/predecessors (never the station)
+    vector<vector<size_t>> succs(n), preds(n);
+    for (size_t u=0; u<n; ++u) {
+        for (size_t v=0; v<n; ++v)
+            if (v!=u && v!=dr.station()) {
+                succs[u].push_back(v);
+                preds[u].push_back(v);
+            }
+        sort(succs[u].begin(), succs[u].end(), [&](size_t a, size_t b)
+                {return c(u, a)<c(u, b);});
+        sort(preds[u].begin(), preds[u].end(), [&](size_t a, size_t b)
+                {return c(a, u)<c(b, u);});
+        succs[u].resize(k);
+        preds[u].resize(k);
+    }
+    const auto near=[](const vector<size_t>& list, size_t v) {
+        return find(list.begin(), list.end(), v)!=list.end();
+    };
+    mt19937 g(42);
+    double total=0, totalmy=0;
+    for (size_t trial=0; trial<30; ++trial) {
+        vector<size_t> tour(1, dr.station());
+        for (size_t i=0; i<n; ++i)
+            if (i!=dr.station())
+                tour.push_back(i);
+        shuffle(tour.begin()+1, tour.end(), g);
+        const double before=pathCost(dr, tour)+c(tour.back(), tour[0]);
+        auto opt=tour;
+        const bool improved=ls.optimize(opt.data());
+        const auto& t=opt;
+        const double after=pathCost(dr, t)+c(t.back(), t[0]);
+        const string what="local search, trial "+to_string(trial);
+        expect(t[0]==tour[0] && t[1]==tour[1] && t.back()==tour.back()
+                && is_permutation(t.begin(), t.end(), tour.begin()),
+                what+" (stops)");
+        expect(after<=before+1e-6 && improved==(t!=tour)
+                && improved==(after<before-1e-6), what+" (cost)");
+        // reversal of [i,j] changes the cost of the arcs inside
+        const auto reversal=[&](size_t i, size_t j) {
+            double d=0;
+            for (size_t p=i; p<j; ++p)
+                d+=c(t[p+1], t[p])-c(t[p], t[p+1]);
+            return d;
+        };
+        size_t left=0;
+        for (size_t i=2; i<n-1; ++i)
+            for (size_t j=i+1; j<n-1; ++j) {
+                const bool covered=(near(succs[t[i-1]], t[j])
+                        && c(t[i-1], t[j])<c(t[i-1], t[i]))
+                        || (near(succs[t[i]], t[j+1])
+                        && c(t[i], t[j+1])<c(t[i], t[i+1]))
+                        || (near(preds[t[j]], t[i-1])
+                        && c(t[i-1], t[j])<c(t[j-1], t[j]))
+                        || (near(preds[t[j+1]], t[i])
+                        && c(t[i], t[j+1])<c(t[j], t[j+1]));
+                const double delta=c(t[i-1], t[j])+c(t[i], t[j+1])
+                        -c(t[i-1], t[i])-c(t[j], t[j+1])+reversal(i, j);
+                if (covered && delta<-1e-5)
+                    left++;
+            }
+        for (size_t s=2; s<n-1; ++s) {
+            const size_t f=t[s];
+            const double gain=c(t[s-1], f)+c(f, t[s+1])-c(t[s-1], t[s+1]);
+            for (size_t x=1; x<n-1; ++x) {
+                if (x+1==s || x==s)
+                    continue;
+                const bool covered=(near(succs[f], t[x+1])
+                        && c(f, t[x+1])<gain)
+                        || (near(preds[f], t[x]) && c(t[x], f)<gain);
+                const double delta=c(t[x], f)+c(f, t[x+1])-c(t[x], t[x+1])
+                        -gain;
+                if (covered && delta<-1e-5)
+                    left++;
+            }
+        }
+        expect(left==0, what+" ("+to_string(left)+" improving moves left)");
+        Sequence seq=toSequence(dr, tour);
+        LocalSearch::myOpt(seq, r);
+        total+=after;
+        totalmy+=pathCost(dr, dr.toTour(seq))+c(dr.toTour(seq).back(),
+                tour[0]);
+    }
+    expect(total<totalmy, "local search against myOpt: "+to_string(total)
+            +" vs "+to_string(totalmy));
+}
+
+// tours made of blocks of a timed tour, as the moves of the timing search
+// see them: the concatenated summaries of the blocks (shifted in time) must
+// match TimingEvaluator whenever they claim to be exact, and both exact and
+// extrapolated results must occur; optimizeTiming must not worsen a tour
+static void checkTimingSummaries() {
+    typedef TimingSummary Summary;
+    const auto r=syntheticRoute(60, 47, 0.6);
+    const DenseRoute dr(r);
+    const size_t n=dr.size();
+    LocalSearch ls(dr);
+    mt19937 g(47);
+    size_t exact=0, inexact=0;
+    for (size_t trial=0; trial<400; ++trial) {
+        vector<size_t> tour(1, dr.station());
+        for (size_t i=0; i<n; ++i)
+            if (i!=dr.station())
+                tour.push_back(i);
+        shuffle(tour.begin()+1, tour.end(), g);
+        vector<Summary> stopsum(n);
+        stopsum[0]=Summary::stop(dr, tour[0], 0, 0);
+        Summary pre=stopsum[0];
+        for (size_t p=1; p<n; ++p) {
+            stopsum[p]=Summary::after(dr, pre, tour[p]);
+            pre=Summary::concat(dr, pre, stopsum[p]);
+        }
+        // 2-5 blocks [cuts[b], cuts[b+1]) of positions 1..n-1, reordered
+        vector<size_t> cuts(1, 1);
+        for (size_t k=0; k<1+trial%4; ++k)
+            cuts.push_back(2+g()%(n-2));
+        cuts.push_back(n);
+        sort(cuts.begin(), cuts.end());
+        cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+        vector<size_t> blocks(cuts.size()-1);
+        iota(blocks.begin(), blocks.end(), 0);
+        shuffle(blocks.begin(), blocks.end(), g);
+        Summary sum=stopsum[0];
+        vector<size_t> moved(1, tour[0]);
+        for (const auto b : blocks) {
+            Summary block=stopsum[cuts[b]];
+            for (size_t p=cuts[b]+1; p<cuts[b+1]; ++p)
+                block=Summary::concat(dr, block, stopsum[p]);
+            sum=Summary::concat(dr, sum, block);
+            moved.insert(moved.end(), tour.begin()+cuts[b],
+                    tour.begin()+cuts[b+1]);
+        }
+        const auto t=TimingEvaluator::timing(dr, moved.data(), n);
+        const double duration=sum.duration+dr.travelTime(sum.last, moved[0]);
+        expect(fabs(duration-t.duration)<=1e-6, "summary duration, trial "
+                +to_string(trial));
+        if (!sum.exact) {
+            inexact++;
+            continue;
+        }
+        exact++;
+        expect(fabs(sum.earliness-t.earliness)<=1e-6
+                && fabs(sum.lateness-t.lateness)<=1e-6,
+                "exact summary, trial "+to_string(trial));
+    }
+    expect(exact>0 && inexact>0, "summaries: "+to_string(exact)+" exact, "
+            +to_string(inexact)+" extrapolated");
+    for (size_t trial=0; trial<3; ++trial) {
+        vector<size_t> tour(1, dr.station());
+        for (size_t i=0; i<n; ++i)
+            if (i!=dr.station())
+                tour.push_back(i);
+        shuffle(tour.begin()+1, tour.end(), g);
+        const auto before=TimingEvaluator::timing(dr, tour.data(), n);
+        auto opt=tour;
+        const bool improved=ls.optimizeTiming(opt.data());
+        const auto after=TimingEvaluator::timing(dr, opt.data(), n);
+        const string what="optimizeTiming, trial "+to_string(trial);
+        expect(opt[0]==tour[0] && opt[1]==tour[1] && opt.back()==tour.back()
+                && is_permutation(opt.begin(), opt.end(), tour.begin()),
+                what+" (stops)");
+        expect(after.cost()<=before.cost()+1e-6
+                && improved==(opt!=tour), what+" (cost)");
+    }
+}
+
+int main() {
+    checkAliasTable();
+    checkErp();
+    checkConstruction();
+    checkInsertion();
+    checkHeldKarp();
+    checkHierarchical();
+    checkLocalSearch();
+    checkTimeWindowInsertion();
+    checkPoolDeterminism();
+    checkSequenceEvaluator();
+    checkTimingEvaluator();
+    checkTimingSummaries();
+    if (failures==0)
+        cout<<"all checks passed"<<endl;
+    else
+        cout<<failures<<" checks failed"<<endl;
+    return failures==0 ? 0 : 1;
+}
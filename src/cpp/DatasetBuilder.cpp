@@ -1,8 +1,8 @@
 #include <algorithm>
 #include <iostream>
-#include <random>
 #include "DatasetBuilder.h"
 #include "JSONParser.h"
+#include "Random.h"
 
 using namespace std;
 using namespace rapidjson;
@@ -100,8 +100,7 @@ vector<string> DatasetBuilder::sampleRoutes(
     for (const auto& r : routes)
         map[r.mainMacroZone()].push_back(r.id());
     // shuffle all route ids within each macro zone bucket
-    random_device rd;
-    mt19937 g(rd());
+    auto g=Random::stream("", Random::Purpose::sampling);
     for (auto& kv : map)
         shuffle(kv.second.begin(), kv.second.end(), g);
     unordered_map<string, vector<string>> tomove;
@@ -128,8 +127,7 @@ vector<pair<string, int>> DatasetBuilder::sampleRoutes(
     for (const auto& r : routes)
         map[r.mainMacroZone()].push_back(r.id());
     // shuffle all route ids within each macro zone bucket
-    random_device rd;
-    mt19937 g(rd());
+    auto g=Random::stream("", Random::Purpose::sampling, 1);
     for (auto& kv : map)
         shuffle(kv.second.begin(), kv.second.end(), g);
     unordered_map<string, vector<string>> tomove;
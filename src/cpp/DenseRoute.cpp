@@ -0,0 +1,64 @@
+#include <chrono>
+#include <iostream>
+#include "DenseRoute.h"
+#include "Route.h"
+
+using namespace std;
+
+DenseRoute::DenseRoute(const Route& r) : n{r.stops().size()},
+        stationcode{r.station()}, idx_to_stop(n), ttimes(n*n), tt_early(n*n),
+        tt_late(n*n), st_early(n), st_late(n), hastw(n, 0), tw_start(n, 0),
+        tw_end(n, 0), unknownzone(n, 0) {
+    const auto& tts=r.travelTimes();
+    if (tts.size()!=n)
+        cout<<"warning: travel time matrix and stops differ in size"<<endl;
+    unordered_map<string, int> zonetoid[3];
+    for (size_t l=0; l<3; ++l) {
+        zoneids[l].assign(n, 0);
+        zonenames[l].push_back("");
+        zonetoid[l][""]=0;
+    }
+    for (const auto& kv : r.stops()) {
+        const auto& s=kv.second;
+        const size_t i=tts.index(kv.first);
+        idx_to_stop[i]=kv.first;
+        stop_to_idx[kv.first]=i;
+        const string zs[3]={s.macroZone(), s.microZone(), s.nanoZone()};
+        for (size_t l=0; l<3; ++l) {
+            if (zonetoid[l].count(zs[l])==0) {
+                zonetoid[l][zs[l]]=zonenames[l].size();
+                zonenames[l].push_back(zs[l]);
+            }
+            zoneids[l][i]=zonetoid[l].at(zs[l]);
+        }
+        unknownzone[i]=s.type()==Stop::Type::dropoff && s.nanoZone()=="";
+        if (s.type()==Stop::Type::station)
+            station_=i;
+        // same rounding as in Route::setupTiming
+        const double stime=s.serviceTime();
+        st_early[i]=static_cast<int>(0.5+0.90*stime);
+        st_late[i]=static_cast<int>(0.5+1.10*stime);
+        if (s.hasTW()) {
+            hastw[i]=1;
+            tw_start[i]=chrono::duration_cast<chrono::seconds>(
+                    s.startTW()-r.departure()).count();
+            tw_end[i]=chrono::duration_cast<chrono::seconds>(
+                    s.endTW()-r.departure()).count();
+        }
+    }
+    for (size_t i=0; i<n; ++i)
+        for (size_t j=0; j<n; ++j) {
+            const double t=tts.travelTime(i, j);
+            ttimes[i*n+j]=t;
+            tt_early[i*n+j]=static_cast<int>(0.5+0.75*t);
+            tt_late[i*n+j]=static_cast<int>(0.5+1.25*t);
+        }
+}
+
+vector<size_t> DenseRoute::toTour(const Sequence& seq) const {
+    vector<size_t> tour;
+    tour.reserve(seq.stops().size());
+    for (const auto& s : seq.stops())
+        tour.push_back(stop_to_idx.at(s));
+    return tour;
+}
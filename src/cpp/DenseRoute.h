@@ -0,0 +1,59 @@
+#ifndef denseroute_h
+#define denseroute_h
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Route;
+class Sequence;
+// flat copy of the route data used in hot loops; stops are identified by their
+// index in the route's travel time matrix
+class DenseRoute {
+    public:
+        enum class Level {macro, micro, nano};
+    private:
+        size_t n;
+        size_t station_=0;
+        std::string stationcode;
+        std::vector<std::string> idx_to_stop;
+        std::unordered_map<std::string, size_t> stop_to_idx;
+        std::vector<double> ttimes;             // n x n, row-major
+        std::vector<int> tt_early, tt_late;     // rounded 0.75/1.25 x ttimes
+        std::vector<int> st_early, st_late;     // rounded 0.90/1.10 x stimes
+        std::vector<char> hastw;
+        std::vector<long> tw_start, tw_end;     // seconds after departure
+        // zone ids per level; id 0 is reserved for the empty zone ""
+        std::vector<int> zoneids[3];
+        std::vector<std::string> zonenames[3];
+        // dropoffs with unknown nano zone (ignored by Route::setupSimilarity)
+        std::vector<char> unknownzone;
+        static size_t level(Level l) {return static_cast<size_t>(l);}
+    public:
+        DenseRoute(const Route& r);
+        int earlyServiceTime(size_t i) const {return st_early[i];}
+        int earlyTravelTime(size_t from, size_t to) const
+                {return tt_early[from*n+to];}
+        long endTW(size_t i) const {return tw_end[i];}
+        bool hasTW(size_t i) const {return hastw[i];}
+        const std::string& id(size_t i) const {return idx_to_stop[i];}
+        size_t index(const std::string& stopid) const
+                {return stop_to_idx.at(stopid);}
+        int lateServiceTime(size_t i) const {return st_late[i];}
+        int lateTravelTime(size_t from, size_t to) const
+                {return tt_late[from*n+to];}
+        size_t size() const {return n;}
+        long startTW(size_t i) const {return tw_start[i];}
+        size_t station() const {return station_;}
+        const std::string& stationCode() const {return stationcode;}
+        std::vector<size_t> toTour(const Sequence& seq) const;
+        double travelTime(size_t from, size_t to) const
+                {return ttimes[from*n+to];}
+        bool unknownZone(size_t i) const {return unknownzone[i];}
+        int zone(Level l, size_t i) const {return zoneids[level(l)][i];}
+        const std::string& zoneName(Level l, int z) const
+                {return zonenames[level(l)][z];}
+        size_t zones(Level l) const {return zonenames[level(l)].size();}
+};
+
+#endif
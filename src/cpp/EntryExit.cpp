@@ -1,62 +1,163 @@
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <random>
+#include <unordered_map>
+#include "AliasTable.h"
 #include "EntryExit.h"
 #include "LocalSearch.h"
+#include "Random.h"
 #include "SequenceBuilder.h"
 
 using namespace std;
 
-vector<Sequence> EntryExit::findSequences(size_t n, const Route& r,
-        const AlgoInput& input) const {
-    vector<string> entrystops, exitstops;
-    vector<string> dropoffs;
+// a stop is drawn with probability proportional to the number of entries
+// (exits) of its nano zone: an alias table over the nano zones of the route,
+// weighted by count x stops of the zone, then a stop of the zone uniformly;
+// without any history all dropoffs are equally likely
+vector<pair<string, string>> EntryExit::combinations(size_t n,
+        const Route& r, const AlgoInput& input) const {
+    unordered_map<string, size_t> zoneidx;
+    vector<vector<string>> zonestops;
     for (const auto& kv : r.stops()) {
         const auto& stop=kv.second;
         if (stop.type()==Stop::Type::dropoff) {
-            dropoffs.push_back(stop.id());
-            size_t entries=input.pattern().countEntriesNano(stop.nanoZone());
-            size_t exits=input.pattern().countExitsNano(stop.nanoZone());
-            while (entries-- > 0)
-                entrystops.push_back(stop.id());
-            while (exits-- > 0)
-                exitstops.push_back(stop.id());
+            const auto it=zoneidx.insert({stop.nanoZone(), zonestops.size()});
+            if (it.second)
+                zonestops.emplace_back();
+            zonestops[it.first->second].push_back(stop.id());
         }
     }
-    if (entrystops.empty())
-        entrystops=dropoffs;
-    if (exitstops.empty())
-        exitstops=dropoffs;
+    vector<double> wentry(zonestops.size()), wexit(zonestops.size());
+    vector<double> wdropoff(zonestops.size());
+    for (const auto& kv : zoneidx) {
+        const double stops=zonestops[kv.second].size();
+        wentry[kv.second]=stops*input.pattern().countEntriesNano(kv.first);
+        wexit[kv.second]=stops*input.pattern().countExitsNano(kv.first);
+        wdropoff[kv.second]=stops;
+    }
+    AliasTable entries(wentry), exits(wexit);
+    if (entries.empty())
+        entries=AliasTable(wdropoff);
+    if (exits.empty())
+        exits=AliasTable(wdropoff);
     vector<pair<string, string>> combis;
-    random_device rd;
-    mt19937 g(rd());
-    uniform_int_distribution<> randomentry(0, entrystops.size()-1);
-    uniform_int_distribution<> randomexit(0, exitstops.size()-1);
+    if (entries.empty()) {
+        cout<<"0 entry/exit pairs available\n";
+        return combis;
+    }
+    auto g=Random::stream(r.id(), Random::Purpose::entryExit);
+    const auto sample=[&g, &zonestops](const AliasTable& t) -> const string& {
+        const auto& stops=zonestops[t(g)];
+        return stops[uniform_int_distribution<size_t>(0, stops.size()-1)(g)];
+    };
     for (size_t i=0; i<n; ++i) {
-        size_t idxentry=randomentry(g);
-        size_t idxexit=randomexit(g);
-        if (entrystops[idxentry]!=exitstops[idxexit])
-            combis.push_back({entrystops[idxentry], exitstops[idxexit]});
+        const string& entry=sample(entries);
+        const string& exit=sample(exits);
+        if (entry!=exit)
+            combis.push_back({entry, exit});
     }
     cout<<combis.size()<<" entry/exit pairs available\n";
-    auto pool=SequenceBuilder::buildRandom(r, combis, p_micro, p_nano);
-    for (size_t i=0; i<combis.size(); ++i) {
-        if (pool[i].stops()[1]!=combis[i].first
-                || pool[i].stops().back()!=combis[i].second)
-            cout<<"warning: invalid entry or exit stop"<<endl;
-    }
+    return combis;
+}
+
+SequencePool EntryExit::findSequences(size_t n, const Route& r,
+        const AlgoInput& input) const {
+    auto pool=construction==Construction::hierarchical
+            ? SequenceBuilder::buildHierarchical(r, n, input.pattern())
+            : SequenceBuilder::buildRandom(r, combinations(n, r, input),
+            p_micro, p_nano, insertion);
+    cout<<pool.duplicates()<<" duplicated sequences dropped ("
+            <<100*pool.duplicationRate()<<"%)\n";
     if (pool.empty()) {
         cout<<"no entry/exit sequence available: pooling "<<n
                 <<" sequences randomly"<<endl;
         pool=SequenceBuilder::buildRandom(r, n, p_micro, p_nano);
     }
     cout<<"pool size: "<<pool.size()<<'\n';
-    if (localsearch) {
-        cout<<"applying local search ..."<<endl;
-        for (auto& seq : pool)
-            if (LocalSearch::myOpt(seq, r))
-                r.setupTiming(seq);
+    improve(pool, 0);
+    return pool;
+}
+
+SequencePool EntryExit::findSequences(const Route& r, const AlgoInput& input,
+        const Predictor& predict) const {
+    if (chunk==0)
+        return findSequences(r, input);
+    if (construction==Construction::hierarchical) {
+        auto pool=findSequences(r, input);
+        Algorithm::evaluate(pool, input.pattern());
+        return pool;
+    }
+    // the pairs of a full pool: a pool stopped early is a prefix of it
+    const auto combis=combinations(poolsize, r, input);
+    SequencePool pool(r);
+    pool.reserve(combis.size());
+    const auto bypool=[&pool](size_t i, size_t j){return better(pool, i, j);};
+    double ratio=0, score=0;        // after the previous chunk
+    size_t done=0, chunks=0;
+    while (done<combis.size()) {
+        const size_t m=min(chunk, combis.size()-done), from=pool.size();
+        SequenceBuilder::addRandom(pool, r, vector<pair<string, string>>(
+                combis.begin()+done, combis.begin()+done+m), done, p_micro,
+                p_nano, insertion);
+        done+=m;
+        improve(pool, from);
+        Algorithm::evaluate(pool, input.pattern());
+        if (pool.empty())
+            continue;
+        const auto& rows=pool.rows();
+        const double best=pool.simByTransNano(*min_element(rows.begin(),
+                rows.end(), bypool));
+        const double pscore=predict ? predict(pool) : 0;
+        const bool plateau=chunks++>0 && fabs(best-ratio)<=tol*fabs(ratio)
+                && fabs(pscore-score)<=tol*fabs(score);
+        ratio=best;
+        score=pscore;
+        if (plateau && done>=minsize)
+            break;
+    }
+    if (done<combis.size())
+        cout<<"pool converged after "<<done<<" pairs\n";
+    cout<<pool.duplicates()<<" duplicated sequences dropped ("
+            <<100*pool.duplicationRate()<<"%)\n";
+    if (pool.empty()) {
+        cout<<"no entry/exit sequence available: pooling "<<poolsize
+                <<" sequences randomly"<<endl;
+        pool=SequenceBuilder::buildRandom(r, poolsize, p_micro, p_nano);
+        improve(pool, 0);
+        Algorithm::evaluate(pool, input.pattern());
     }
+    cout<<"pool size: "<<pool.size()<<'\n';
     return pool;
 }
 
+void EntryExit::improve(SequencePool& pool, size_t from) const {
+    if (improvement==Improvement::none)
+        return;
+    cout<<"applying local search ..."<<endl;
+    // rows are independent: each one only writes its own tour and timing
+    const vector<size_t> rows(pool.rows().begin()+from, pool.rows().end());
+    vector<char> changed(rows.size(), 0);
+    if (improvement==Improvement::swaps) {
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t k=0; k<rows.size(); ++k)
+            changed[k]=LocalSearch::timingOpt(pool, rows[k]);
+    } else {
+        #pragma omp parallel
+        {
+            LocalSearch ls(pool.route());       // one workspace per thread
+            #pragma omp for schedule(dynamic)
+            for (size_t k=0; k<rows.size(); ++k)
+                if (improvement==Improvement::travel)
+                    changed[k]=ls.optimize(pool, rows[k]);
+                else if (improvement==Improvement::zones)
+                    changed[k]=ls.zoneOpt(pool, rows[k]);
+                else
+                    changed[k]=ls.optimizeTiming(pool, rows[k]);
+        }
+    }
+    // improved tours may now be duplicates
+    for (size_t k=0; k<rows.size(); ++k)
+        if (changed[k])
+            pool.retour(rows[k]);
+}
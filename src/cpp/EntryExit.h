@@ -4,24 +4,81 @@
 #include <string>
 #include <vector>
 #include "Algorithm.h"
+#include "TSPHeuristic.h"
 
 class EntryExit : public Algorithm {
+    public:
+        // local search on the pooled tours (see LocalSearch): swaps of
+        // adjacent stops judged on timing (timingOpt), 2-opt/Or-opt on
+        // travel time (optimize), runs of a nano zone reordered (zoneOpt) or
+        // 2-opt/Or-opt/swaps judged on timing (optimizeTiming)
+        enum class Improvement {none, swaps, travel, zones, timing};
+        // pooled tours: one per sampled entry/exit pair (see insertion), or
+        // built zone by zone (SequenceBuilder::buildHierarchical: no flat TSP,
+        // for large routes; the insertion and zone penalties only apply to
+        // pairs)
+        enum class Construction {pairs, hierarchical};
     private:
         const size_t poolsize;
         const double p_micro;
         const double p_nano;
-        const bool localsearch;
+        const Improvement improvement;
+        const TSPHeuristic::Insertion insertion;    // tour per entry/exit
+        const Construction construction;
+        // adaptive pool (chunk>0): pairs are added 'chunk' at a time until the
+        // best nano similarity by transitions and the predicted score change
+        // by at most 'tol' (relative) over a chunk, with at least 'minsize'
+        // and at most poolsize pairs; opt-in, as training pools have a fixed
+        // size and pool-level route features depend on it (hierarchical
+        // pools are always built in full)
+        const size_t chunk, minsize;
+        const double tol;
+        std::vector<std::pair<std::string, std::string>> combinations(size_t n,
+                const Route& r, const AlgoInput& input) const;
+        // local search on the rows from position 'from' of pool.rows() on
+        void improve(SequencePool& pool, size_t from) const;
     public:
-        EntryExit(size_t s, double pm, double pn, bool ls) : poolsize{s},
-                p_micro{pm}, p_nano{pn}, localsearch{ls} {
+        EntryExit(size_t s, double pm, double pn, Improvement imp,
+                TSPHeuristic::Insertion ins=TSPHeuristic::Insertion::random,
+                Construction con=Construction::pairs, size_t ch=0,
+                size_t mins=0, double tl=0)
+                : poolsize{s}, p_micro{pm}, p_nano{pn}, improvement{imp},
+                insertion{ins}, construction{con}, chunk{ch}, minsize{mins},
+                tol{tl} {
             id_="EE-"+std::to_string(p_micro)+"-"+std::to_string(p_nano);
+            if (construction==Construction::hierarchical)
+                id_+="-hierarchical";
+            else if (insertion==TSPHeuristic::Insertion::cheapest)
+                id_+="-cheapest";
+            else if (insertion==TSPHeuristic::Insertion::farthest)
+                id_+="-farthest";
+            else if (insertion==TSPHeuristic::Insertion::timeWindows)
+                id_+="-tw";
+            if (improvement==Improvement::travel)
+                id_+="-travel";
+            else if (improvement==Improvement::zones)
+                id_+="-zones";
+            else if (improvement==Improvement::timing)
+                id_+="-timing";
+            if (chunk>0 && construction==Construction::pairs)
+                id_+="-adaptive";
         }
-        std::vector<Sequence> findSequences(size_t n, const Route& r,
+        // ls: adjacent swaps (Improvement::swaps) or none
+        EntryExit(size_t s, double pm, double pn, bool ls,
+                TSPHeuristic::Insertion ins=TSPHeuristic::Insertion::random,
+                Construction con=Construction::pairs, size_t ch=0,
+                size_t mins=0, double tl=0)
+                : EntryExit(s, pm, pn, ls ? Improvement::swaps
+                : Improvement::none, ins, con, ch, mins, tl) {}
+        SequencePool findSequences(size_t n, const Route& r,
                 const AlgoInput& input) const override;
-        std::vector<Sequence> findSequences(const Route& r,
+        SequencePool findSequences(const Route& r,
                 const AlgoInput& input) const override {
             return findSequences(poolsize, r, input);
         }
+        // the pool is evaluated (see Algorithm::evaluate) if chunk>0
+        SequencePool findSequences(const Route& r, const AlgoInput& input,
+                const Predictor& predict) const override;
         bool randomized() const override {return true;}
 };
 
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <armadillo>
+#include "FactoredModel.h"
+
+using namespace std;
+
+FactoredModel::FactoredModel(const LassoRegression& model,
+        const string& station) : a(FeatureRegistry::SQ_N, 0),
+        a_off(FeatureRegistry::SQ_N, 0),
+        B(FeatureRegistry::SQ_N*FeatureRegistry::RT_N, 0),
+        B_off(FeatureRegistry::SQ_N*FeatureRegistry::RT_N, 0),
+        w(FeatureRegistry::SQ_N, 0) {
+    typedef FeatureRegistry FR;
+    const auto names=FR::featureNames(station);
+    const auto schema=model.schema(names);
+    empty_=model.empty();
+    for (size_t k=0; k<schema.slots.size(); ++k) {
+        const size_t slot=schema.slots[k];
+        const double coef=schema.beta[k]/schema.range[k];
+        const double off=-schema.beta[k]*schema.min[k]/schema.range[k];
+        if (slot<2*FR::SQ_N) {              // raw or station_*_ feature
+            a[slot%FR::SQ_N]+=coef;
+            a_off[slot%FR::SQ_N]+=off;
+        } else if (slot<2*FR::SQ_N+FR::SQ_N*FR::RT_N) {
+            B[slot-2*FR::SQ_N]=coef;
+            B_off[slot-2*FR::SQ_N]=off;
+        } else                              // intercept feature
+            beta_0+=coef+off;
+    }
+    beta_0+=model.intercept();
+}
+
+double FactoredModel::predict(const double* sf) const {
+    if (empty_)
+        return numeric_limits<double>::max();
+    double pred=c;
+    for (const auto s : active)
+        pred+=w[s]*sf[s];
+    return pred;
+}
+
+void FactoredModel::predict(const double* S, size_t n, double* y) const {
+    typedef FeatureRegistry FR;
+    const size_t gemv_min=256;      // smaller pools: plain simd loop
+    if (empty_) {
+        fill(y, y+n, numeric_limits<double>::max());
+        return;
+    }
+    if (n<gemv_min) {
+        const double* ws=w.data();
+        for (size_t k=0; k<n; ++k, S+=FR::SQ_N) {
+            double pred=c;
+            #pragma omp simd reduction(+:pred)
+            for (size_t s=0; s<FR::SQ_N; ++s)
+                pred+=ws[s]*S[s];
+            y[k]=pred;
+        }
+        return;
+    }
+    // armadillo views on the caller's memory (no copies)
+    const arma::mat Sm(const_cast<double*>(S), FR::SQ_N, n, false, true);
+    const arma::vec wv(const_cast<double*>(w.data()), FR::SQ_N, false, true);
+    arma::rowvec yv(y, n, false, true);
+    yv=wv.t()*Sm;
+    yv+=c;
+}
+
+void FactoredModel::setRoute(const FeatureRegistry::Stats& stats,
+        const double* rt) {
+    typedef FeatureRegistry FR;
+    // products with non-finite route features are zeroed in the features
+    double r[FR::RT_N];
+    for (size_t j=0; j<FR::RT_N; ++j)
+        r[j]=isfinite(rt[j]) ? rt[j] : 0;
+    c=beta_0;
+    active.clear();
+    for (size_t s=0; s<FR::SQ_N; ++s) {
+        w[s]=0;
+        if (FR::sequenceApplies[s]!=nullptr && !FR::sequenceApplies[s](stats,rt))
+            continue;
+        active.push_back(s);
+        w[s]=a[s];
+        c+=a_off[s];
+        for (size_t j=0; j<FR::RT_N; ++j) {
+            w[s]+=B[s*FR::RT_N+j]*r[j];
+            c+=B_off[s*FR::RT_N+j];
+        }
+    }
+}
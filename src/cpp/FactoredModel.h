@@ -0,0 +1,34 @@
+#ifndef factoredmodel_h
+#define factoredmodel_h
+
+#include <string>
+#include <vector>
+#include "FeatureRegistry.h"
+#include "LassoRegression.h"
+
+// evaluation model with the sequence x route interaction betas kept as a
+// matrix B (sequence features x route features); once the route is set,
+// w=a+B*r and the prediction for a sequence is c+w^T*s (s: FeatureRegistry
+// sequence features); normalization is folded into the coefficients
+class FactoredModel {
+    private:
+        bool empty_=true;
+        double beta_0=0;
+        // coefficient (beta/range) and offset (-beta*min/range) per feature
+        std::vector<double> a, a_off;       // raw and station_*_ features
+        std::vector<double> B, B_off;       // interactions, row-major
+        // set per route
+        std::vector<double> w;              // 0 for features not applying
+        std::vector<size_t> active;         // applicable sequence features
+        double c=0;
+    public:
+        FactoredModel(const LassoRegression& model, const std::string& station);
+        double predict(const double* sf) const;
+        // S: column-major matrix of n sequence feature vectors (features that
+        // do not apply are 0, see FeatureRegistry); y: n predictions
+        void predict(const double* S, size_t n, double* y) const;
+        void setRoute(const FeatureRegistry::Stats& stats, const double* rt);
+        const std::vector<double>& weights() const {return w;}
+};
+
+#endif
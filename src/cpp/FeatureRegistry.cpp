@@ -0,0 +1,284 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include "FeatureRegistry.h"
+#include "Route.h"
+#include "Sequence.h"
+#include "SequencePool.h"
+
+using namespace std;
+
+typedef FeatureRegistry FR;
+
+constexpr const char* FeatureRegistry::routeNames[];
+constexpr const char* FeatureRegistry::sequenceNames[];
+static_assert(FR::routeNames[FR::RT_N-1]!=nullptr,
+        "missing route feature name");
+static_assert(FR::sequenceNames[FR::SQ_N-1]!=nullptr,
+        "missing sequence feature name");
+
+// route features
+static double nStops(const Route& r, const FR::Stats&, const double*) {
+    return r.stops().size()-1;
+}
+static double nTws(const Route& r, const FR::Stats&, const double*) {
+    return r.countTimeWindows(0, 361);
+}
+static double nStrictTws(const Route& r, const FR::Stats&, const double*) {
+    return r.countTimeWindows(0, 241);
+}
+static double pTws(const Route&, const FR::Stats&, const double* rt) {
+    return rt[FR::RT_N_TWS]/rt[FR::RT_N_STOPS];
+}
+static double pStrictTws(const Route&, const FR::Stats&, const double* rt) {
+    return rt[FR::RT_N_STRICT_TWS]/rt[FR::RT_N_STOPS];
+}
+static double dropoffNearest(const Route& r, const FR::Stats&, const double*) {
+    return r.distanceNearestDropoff();
+}
+static double dropoffArea(const Route& r, const FR::Stats&, const double*) {
+    return r.rectangle().area();
+}
+static double dropoffDensity(const Route&, const FR::Stats&, const double* rt){
+    return rt[FR::RT_N_STOPS]/rt[FR::RT_DROPOFF_AREA];
+}
+static double nPacks(const Route& r, const FR::Stats&, const double*) {
+    return r.numPackages();
+}
+static double packsPerStop(const Route&, const FR::Stats&, const double* rt) {
+    return rt[FR::RT_N_PACKS]/rt[FR::RT_N_STOPS];
+}
+static double serviceTime(const Route& r, const FR::Stats&, const double*) {
+    return r.serviceTime();
+}
+static double distinctMacro(const Route& r, const FR::Stats&, const double*) {
+    return r.distinctMacroZones();
+}
+static double distinctMicro(const Route& r, const FR::Stats&, const double*) {
+    return r.distinctMicroZones();
+}
+static double distinctNano(const Route& r, const FR::Stats&, const double*) {
+    return r.distinctNanoZones();
+}
+static double pWithTotness(const Route&, const FR::Stats& st, const double*) {
+    return st.at("p_with_totness");
+}
+static double pWoutTotness(const Route&, const FR::Stats& st, const double*) {
+    return st.at("p_wout_totness");
+}
+static double pWithOutArr(const Route&, const FR::Stats& st, const double*) {
+    return st.at("p_with_out_arrivals");
+}
+static double pWoutOutArr(const Route&, const FR::Stats& st, const double*) {
+    return st.at("p_wout_out_arrivals");
+}
+static double avgEarliness(const Route&, const FR::Stats& st, const double*) {
+    return st.at("avg_earliness");
+}
+static double avgLateness(const Route&, const FR::Stats& st, const double*) {
+    return st.at("avg_lateness");
+}
+static double avgTotness(const Route&, const FR::Stats& st, const double*) {
+    return st.at("avg_earliness")+st.at("avg_lateness");
+}
+
+const FR::RouteFn FeatureRegistry::routeFns[RT_N]={nStops, nTws, nStrictTws,
+        pTws, pStrictTws, dropoffNearest, dropoffArea, dropoffDensity, nPacks,
+        packsPerStop, serviceTime, distinctMacro, distinctMicro, distinctNano,
+        pWithTotness, pWoutTotness, pWithOutArr, pWoutOutArr, avgEarliness,
+        avgLateness, avgTotness};
+
+// sequence features
+typedef const Sequence& Seq;
+typedef const FR::Stats& Stats;
+static double rDuration(Seq s, Stats st, const double*, const double*) {
+    return s.duration()/st.at("min_duration");
+}
+static double durByStime(Seq s, Stats, const double* rt, const double*) {
+    return s.duration()/rt[FR::RT_SERVICE_TIME];
+}
+static double earliness(Seq s, Stats, const double*, const double*) {
+    return s.earliness();
+}
+static double rEarliness(Seq s, Stats, const double* rt, const double*) {
+    return s.earliness()/rt[FR::RT_AVG_EARLINESS];
+}
+static double lateness(Seq s, Stats, const double*, const double*) {
+    return s.lateness();
+}
+static double rLateness(Seq s, Stats, const double* rt, const double*) {
+    return s.lateness()/rt[FR::RT_AVG_LATENESS];
+}
+static double totness(Seq s, Stats, const double*, const double*) {
+    return s.earliness()+s.lateness();
+}
+static double maxStopEarliness(Seq s, Stats, const double*, const double*) {
+    return s.maxEarliness();
+}
+static double maxStopLateness(Seq s, Stats, const double*, const double*) {
+    return s.maxLateness();
+}
+static double maxStopTotness(Seq s, Stats, const double*, const double*) {
+    return s.maxEarliness()+s.maxLateness();
+}
+static double missEarly(Seq s, Stats, const double*, const double*) {
+    return s.earlyArrivals();
+}
+static double missLate(Seq s, Stats, const double*, const double*) {
+    return s.lateArrivals();
+}
+static double outArrivals(Seq s, Stats, const double*, const double*) {
+    return s.earlyArrivals()+s.lateArrivals();
+}
+static double pOutArrivals(Seq s, Stats, const double* rt, const double*) {
+    return (s.earlyArrivals()+s.lateArrivals())/rt[FR::RT_N_TWS];
+}
+static double simMacro(Seq s, Stats, const double*, const double*) {
+    return s.macroSimilarity();
+}
+static double simMicro(Seq s, Stats, const double*, const double*) {
+    return s.microSimilarity();
+}
+static double simNano(Seq s, Stats, const double*, const double*) {
+    return s.nanoSimilarity();
+}
+static double transByDMacro(Seq s, Stats, const double* rt, const double*) {
+    return s.macroTransitions()/rt[FR::RT_DISTINCT_MACRO];
+}
+static double transByDMicro(Seq s, Stats, const double* rt, const double*) {
+    return s.microTransitions()/rt[FR::RT_DISTINCT_MICRO];
+}
+static double transByDNano(Seq s, Stats, const double* rt, const double*) {
+    return s.nanoTransitions()/rt[FR::RT_DISTINCT_NANO];
+}
+static double simByTransMacro(Seq s, Stats, const double*, const double*) {
+    return (1.0*s.macroSimilarity())/s.macroTransitions();
+}
+static double simByTransMicro(Seq s, Stats, const double*, const double*) {
+    return (1.0*s.microSimilarity())/s.microTransitions();
+}
+static double simByTransNano(Seq s, Stats, const double*, const double*) {
+    return (1.0*s.nanoSimilarity())/s.nanoTransitions();
+}
+static double dSimByTransMacro(Seq, Stats st, const double*, const double* sf){
+    return sf[FR::SQ_SIM_BY_TRANS_MACRO]-st.at("min_sim_by_trans_macro");
+}
+static double dSimByTransMicro(Seq, Stats st, const double*, const double* sf){
+    return sf[FR::SQ_SIM_BY_TRANS_MICRO]-st.at("min_sim_by_trans_micro");
+}
+static double dSimByTransNano(Seq, Stats st, const double*, const double* sf) {
+    return sf[FR::SQ_SIM_BY_TRANS_NANO]-st.at("min_sim_by_trans_nano");
+}
+static double rSimByTransMacro(Seq, Stats st, const double*, const double* sf){
+    return sf[FR::SQ_SIM_BY_TRANS_MACRO]/st.at("max_sim_by_trans_macro");
+}
+static double rSimByTransMicro(Seq, Stats st, const double*, const double* sf){
+    return sf[FR::SQ_SIM_BY_TRANS_MICRO]/st.at("max_sim_by_trans_micro");
+}
+static double rSimByTransNano(Seq, Stats st, const double*, const double* sf) {
+    return sf[FR::SQ_SIM_BY_TRANS_NANO]/st.at("max_sim_by_trans_nano");
+}
+
+const FR::SequenceFn FeatureRegistry::sequenceFns[SQ_N]={rDuration,
+        durByStime, earliness, rEarliness, lateness, rLateness, totness,
+        maxStopEarliness, maxStopLateness, maxStopTotness, missEarly, missLate,
+        outArrivals, pOutArrivals, simMacro, simMicro, simNano, transByDMacro,
+        transByDMicro, transByDNano, simByTransMacro, simByTransMicro,
+        simByTransNano, dSimByTransMacro, dSimByTransMicro, dSimByTransNano,
+        rSimByTransMacro, rSimByTransMicro, rSimByTransNano};
+
+// applicability of ratio features (the ratio is undefined for the pool)
+static bool withEarliness(Stats, const double* rt) {
+    return rt[FR::RT_AVG_EARLINESS]!=0;
+}
+static bool withLateness(Stats, const double* rt) {
+    return rt[FR::RT_AVG_LATENESS]!=0;
+}
+static bool withTws(Stats, const double* rt) {
+    return rt[FR::RT_N_TWS]!=0;
+}
+static bool withSimMacro(Stats st, const double*) {
+    return st.at("max_sim_by_trans_macro")!=0;
+}
+static bool withSimMicro(Stats st, const double*) {
+    return st.at("max_sim_by_trans_micro")!=0;
+}
+static bool withSimNano(Stats st, const double*) {
+    return st.at("max_sim_by_trans_nano")!=0;
+}
+
+const FR::AppliesFn FeatureRegistry::sequenceApplies[SQ_N]={nullptr, nullptr,
+        nullptr, withEarliness, nullptr, withLateness, nullptr, nullptr,
+        nullptr, nullptr, nullptr, nullptr, nullptr, withTws, nullptr, nullptr,
+        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+        nullptr, nullptr, withSimMacro, withSimMicro, withSimNano};
+
+void FeatureRegistry::expand(const double* sf, const double* rt, double* x) {
+    for (size_t s=0; s<SQ_N; ++s)
+        x[s]=x[SQ_N+s]=sf[s];
+    double* exp=x+2*SQ_N;
+    for (size_t s=0; s<SQ_N; ++s)
+        for (size_t r=0; r<RT_N; ++r, ++exp) {
+            *exp=sf[s]*rt[r];
+            if (!isfinite(*exp) && !isnan(sf[s]))
+                *exp=0;
+        }
+    *exp=1;     // intercept term
+}
+
+vector<string> FeatureRegistry::featureNames(const string& station) {
+    return featureNames(vector<string>{station});
+}
+
+vector<string> FeatureRegistry::featureNames(const vector<string>& stations) {
+    vector<string> names(sequenceNames, sequenceNames+SQ_N);
+    for (const auto& station : stations)
+        for (size_t s=0; s<SQ_N; ++s)
+            names.push_back(station+"_*_"+sequenceNames[s]);
+    for (size_t s=0; s<SQ_N; ++s)
+        for (size_t r=0; r<RT_N; ++r)
+            names.push_back(string(sequenceNames[s])+"_*_"+routeNames[r]);
+    names.push_back("intercept");
+    return names;
+}
+
+void FeatureRegistry::routeFeatures(const Route& r, const Stats& stats,
+        double* rt) {
+    for (size_t f=0; f<RT_N; ++f)
+        rt[f]=routeFns[f](r, stats, rt);
+}
+
+void FeatureRegistry::sequenceFeatures(const Sequence& seq, const Stats& stats,
+        const double* rt, double* sf) {
+    if (seq.earlyArrivals()==-1 || seq.lateArrivals()==-1)
+        cout<<"warning: sequence early/late arrivals not set"<<endl;
+    if (seq.macroSimilarity()==-1 || seq.microSimilarity()==-1
+            || seq.nanoSimilarity()==-1)
+        cout<<"warning: sequence similarity not set"<<endl;
+    if (seq.macroTransitions()<=0 || seq.microTransitions()<=0
+            || seq.nanoTransitions()<=0)
+        cout<<"warning: sequence transitions not set or invalid"<<endl;
+    for (size_t f=0; f<SQ_N; ++f)
+        sf[f]=sequenceFns[f](seq, stats, rt, sf);
+    // protection against nan's or inf's
+    for (size_t f=0; f<SQ_N; ++f)
+        if (!isfinite(sf[f])) {
+            cout<<"warning: feature \""<<sequenceNames[f]<<"\" is '"<<sf[f]
+                    <<"'  ;  setting to zero"<<endl;
+            sf[f]=0;
+        }
+    for (size_t f=0; f<SQ_N; ++f)
+        if (sequenceApplies[f]!=nullptr && !sequenceApplies[f](stats, rt))
+            sf[f]=numeric_limits<double>::quiet_NaN();
+}
+
+void FeatureRegistry::sequenceFeatures(const SequencePool& pool,
+        const vector<size_t>& rows, const Stats& stats, const double* rt,
+        double* S) {
+    for (size_t k=0; k<rows.size(); ++k, S+=SQ_N) {
+        sequenceFeatures(pool.summary(rows[k]), stats, rt, S);
+        for (size_t f=0; f<SQ_N; ++f)
+            if (isnan(S[f]))
+                S[f]=0;
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef featureregistry_h
+#define featureregistry_h
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Route;
+class Sequence;
+class SequencePool;
+// route and sequence features of the evaluation model: stable indices, names
+// and compute functions; the dense layout of the basis expansion and the
+// schema hash saved with the model are derived from the name tables
+class FeatureRegistry {
+    public:
+        typedef std::unordered_map<std::string, double> Stats;
+        enum RouteFeature {
+            // RT_N_STOPS..RT_SERVICE_TIME are also TestRoute features
+            RT_N_STOPS, RT_N_TWS, RT_N_STRICT_TWS, RT_P_TWS, RT_P_STRICT_TWS,
+            RT_DROPOFF_NEAREST, RT_DROPOFF_AREA, RT_DROPOFF_DENSITY,
+            RT_N_PACKS, RT_PACKS_PER_STOP, RT_SERVICE_TIME, RT_DISTINCT_MACRO,
+            RT_DISTINCT_MICRO, RT_DISTINCT_NANO,
+            // aggregated over the sequence pool
+            RT_P_WITH_TOTNESS, RT_P_WOUT_TOTNESS, RT_P_WITH_OUT_ARRIVALS,
+            RT_P_WOUT_OUT_ARRIVALS, RT_AVG_EARLINESS, RT_AVG_LATENESS,
+            RT_AVG_TOTNESS, RT_N
+        };
+        enum SequenceFeature {
+            SQ_R_DURATION, SQ_DUR_BY_STIME, SQ_EARLINESS, SQ_R_EARLINESS,
+            SQ_LATENESS, SQ_R_LATENESS, SQ_TOTNESS, SQ_MAX_STOP_EARLINESS,
+            SQ_MAX_STOP_LATENESS, SQ_MAX_STOP_TOTNESS, SQ_MISS_EARLY,
+            SQ_MISS_LATE, SQ_OUT_ARRIVALS, SQ_P_OUT_ARRIVALS, SQ_SIM_MACRO,
+            SQ_SIM_MICRO, SQ_SIM_NANO, SQ_TRANS_BY_DISTINCT_MACRO,
+            SQ_TRANS_BY_DISTINCT_MICRO, SQ_TRANS_BY_DISTINCT_NANO,
+            SQ_SIM_BY_TRANS_MACRO, SQ_SIM_BY_TRANS_MICRO, SQ_SIM_BY_TRANS_NANO,
+            SQ_D_SIM_BY_TRANS_MACRO, SQ_D_SIM_BY_TRANS_MICRO,
+            SQ_D_SIM_BY_TRANS_NANO, SQ_R_SIM_BY_TRANS_MACRO,
+            SQ_R_SIM_BY_TRANS_MICRO, SQ_R_SIM_BY_TRANS_NANO, SQ_N
+        };
+        static constexpr const char* routeNames[RT_N]={"n_stops", "n_tws",
+                "n_strict_tws", "p_tws", "p_strict_tws", "dropoff_nearest",
+                "dropoff_area", "dropoff_density", "n_packs", "packs_per_stop",
+                "service_time", "distinct_macro", "distinct_micro",
+                "distinct_nano", "p_with_totness", "p_wout_totness",
+                "p_with_out_arrivals", "p_wout_out_arrivals", "avg_earliness",
+                "avg_lateness", "avg_totness"};
+        static constexpr const char* sequenceNames[SQ_N]={"r_duration",
+                "dur_by_stime", "earliness", "r_earliness", "lateness",
+                "r_lateness", "totness", "max_stop_earliness",
+                "max_stop_lateness", "max_stop_totness", "miss_early",
+                "miss_late", "out_arrivals", "p_out_arrivals", "sim_macro",
+                "sim_micro", "sim_nano", "trans_by_distinct_macro",
+                "trans_by_distinct_micro", "trans_by_distinct_nano",
+                "sim_by_trans_macro", "sim_by_trans_micro", "sim_by_trans_nano",
+                "d_sim_by_trans_macro", "d_sim_by_trans_micro",
+                "d_sim_by_trans_nano", "r_sim_by_trans_macro",
+                "r_sim_by_trans_micro", "r_sim_by_trans_nano"};
+        // rt: route features with a lower index are already computed
+        typedef double (*RouteFn)(const Route& r, const Stats& stats,
+                const double* rt);
+        typedef double (*SequenceFn)(const Sequence& seq, const Stats& stats,
+                const double* rt, const double* sf);
+        // whether a sequence feature applies to the pool (nullptr: always)
+        typedef bool (*AppliesFn)(const Stats& stats, const double* rt);
+        static const RouteFn routeFns[RT_N];
+        static const SequenceFn sequenceFns[SQ_N];
+        static const AppliesFn sequenceApplies[SQ_N];
+    private:
+        // FNV-1a over the names, each name terminated by a 0 byte
+        static constexpr uint64_t fnv1a(const char* s, uint64_t h) {
+            return *s=='\0' ? (h^0)*1099511628211ULL
+                    : fnv1a(s+1, (h^static_cast<unsigned char>(*s))
+                    *1099511628211ULL);
+        }
+        static constexpr uint64_t fnv1a(const char* const* names, size_t n,
+                uint64_t h) {
+            return n==0 ? h : fnv1a(names+1, n-1, fnv1a(names[0], h));
+        }
+    public:
+        // dense layout: sequence features, station_*_<seq>, <seq>_*_<route>
+        // (sequence-major) and the intercept
+        static constexpr size_t numFeatures() {return SQ_N*(RT_N+2)+1;}
+        // x: basis expansion of sequence features sf (sf may alias x)
+        static void expand(const double* sf, const double* rt, double* x);
+        static std::vector<std::string> featureNames(const std::string& station);
+        // the dense layout with one station block per station, in the given
+        // order (a single station: the layout of expand)
+        static std::vector<std::string> featureNames(
+                const std::vector<std::string>& stations);
+        static void routeFeatures(const Route& r, const Stats& stats,
+                double* rt);
+        static constexpr uint64_t schemaHash() {
+            return fnv1a(sequenceNames, SQ_N, fnv1a(routeNames, RT_N,
+                    fnv1a("seq,station_*_seq,seq_*_route,intercept",
+                    14695981039346656037ULL)));
+        }
+        // features that do not apply are NaN, non-finite values are zeroed
+        static void sequenceFeatures(const Sequence& seq, const Stats& stats,
+                const double* rt, double* sf);
+        // S: column-major SQ_N x rows.size() matrix, one column per row of
+        // the pool (in 'rows' order); features that do not apply are 0
+        static void sequenceFeatures(const SequencePool& pool,
+                const std::vector<size_t>& rows, const Stats& stats,
+                const double* rt, double* S);
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <limits>
+#include "DenseRoute.h"
+#include "HeldKarp.h"
+
+using namespace std;
+
+static const double eps=1e-6;      // minimal improvement
+
+HeldKarp::HeldKarp(size_t c) : cap{min<size_t>(c, 16)} {}
+
+// costs: 0=first stop, 1..q=free stops, q+1=last stop
+bool HeldKarp::exact(size_t* stops) {
+    const size_t full=(size_t(1)<<q)-1;
+    const double inf=numeric_limits<double>::max();
+    if (dp.size()<(full+1)*q) {
+        dp.resize((full+1)*q);
+        parent.resize((full+1)*q);
+    }
+    fill(dp.begin(), dp.begin()+(full+1)*q, inf);
+    for (size_t j=0; j<q; ++j)
+        dp[(size_t(1)<<j)*q+j]=cost(0, j+1);
+    for (size_t mask=1; mask<full; ++mask)
+        for (size_t in=mask; in!=0; in&=in-1) {     // set bits: last stop j
+            const size_t j=__builtin_ctzll(in);
+            const double d=dp[mask*q+j];
+            const double* cj=&costs[(j+1)*(q+2)+1];
+            for (size_t out=full&~mask; out!=0; out&=out-1) {
+                const size_t k=__builtin_ctzll(out);
+                const size_t next=(mask|(size_t(1)<<k))*q+k;
+                if (d+cj[k]<dp[next]) {
+                    dp[next]=d+cj[k];
+                    parent[next]=static_cast<uint8_t>(j);
+                }
+            }
+        }
+    size_t best=0;
+    double bestcost=inf;
+    for (size_t j=0; j<q; ++j) {
+        const double d=dp[full*q+j]+cost(j+1, q+1);
+        if (d<bestcost) {
+            best=j;
+            bestcost=d;
+        }
+    }
+    double currcost=0;
+    for (size_t p=0; p<=q; ++p)
+        currcost+=cost(p, p+1);
+    if (bestcost>=currcost-eps)
+        return false;
+    // walk back from the last free stop
+    path.resize(q+2);
+    for (size_t mask=full, j=best, p=q; p>=1; --p) {
+        path[p]=nodes[j+1];
+        const size_t prev=parent[mask*q+j];
+        mask&=~(size_t(1)<<j);
+        j=prev;
+    }
+    copy(path.begin()+1, path.begin()+q+1, stops+1);
+    return true;
+}
+
+bool HeldKarp::optimize(const DenseRoute& dr, size_t* stops, size_t m) {
+    if (m<4)        // less than 2 free stops
+        return false;
+    q=m-2;
+    nodes.assign(stops, stops+m);
+    costs.resize(m*m);
+    for (size_t i=0; i<m; ++i)
+        for (size_t j=0; j<m; ++j)
+            costs[i*m+j]=dr.travelTime(stops[i], stops[j]);
+    return q<=cap ? exact(stops) : relocate(stops);
+}
+
+// first-improvement relocation of single free stops, until no move helps;
+// path holds positions of the original order (nodes)
+bool HeldKarp::relocate(size_t* stops) {
+    const size_t m=q+2;
+    path.resize(m);
+    for (size_t p=0; p<m; ++p)
+        path[p]=p;
+    bool success=false, improv=true;
+    while (improv) {
+        improv=false;
+        for (size_t s=1; s+1<m; ++s) {
+            const size_t u=path[s];
+            const double gain=cost(path[s-1], u)+cost(u, path[s+1])
+                    -cost(path[s-1], path[s+1]);
+            for (size_t x=0; x+1<m; ++x) {      // between x and x+1
+                if (x==s-1 || x==s)
+                    continue;
+                const double add=cost(path[x], u)+cost(u, path[x+1])
+                        -cost(path[x], path[x+1]);
+                if (add<gain-eps) {
+                    if (x<s)
+                        rotate(path.begin()+x+1, path.begin()+s,
+                                path.begin()+s+1);
+                    else
+                        rotate(path.begin()+s, path.begin()+s+1,
+                                path.begin()+x+1);
+                    improv=success=true;
+                    break;
+                }
+            }
+        }
+    }
+    if (success)
+        for (size_t p=1; p+1<m; ++p)
+            stops[p]=nodes[path[p]];
+    return success;
+}
@@ -0,0 +1,29 @@
+#ifndef heldkarp_h
+#define heldkarp_h
+
+#include <cstdint>
+#include <vector>
+
+class DenseRoute;
+// shortest path through a small set of stops with fixed first and last stop
+// (Held-Karp DP over subsets); tables are kept and reused across calls;
+// paths with more than 'cap' free stops are improved by relocating single
+// stops instead
+class HeldKarp {
+    private:
+        const size_t cap;
+        std::vector<double> dp;         // 2^q x q: best path ending at j
+        std::vector<uint8_t> parent;
+        std::vector<double> costs;      // (q+2) x (q+2), 0=first, q+1=last
+        std::vector<size_t> nodes, path;
+        size_t q=0;                     // free stops
+        double cost(size_t i, size_t j) const {return costs[i*(q+2)+j];}
+        bool exact(size_t* stops);
+        bool relocate(size_t* stops);
+    public:
+        HeldKarp(size_t c=12);
+        // reorders stops[1..m-2]; true if the path got shorter
+        bool optimize(const DenseRoute& dr, size_t* stops, size_t m);
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <memory>
 #include <numeric>
 #include <random>
+#include <set>
 #include <string>
 #include <mlpack/core.hpp>
 #include <mlpack/methods/lars/lars.hpp>
@@ -15,51 +16,67 @@
 using namespace std;
 
 void LassoRegression::checkData() const {
-    for (const auto& dp : cv_data) {
-        if (!isfinite(dp.y))
-            cout<<"warning: y value is '"<<dp.y<<"'"<<endl;
-        for (const auto& kv : dp.x)
-            if (!isfinite(kv.second)) {
-                cout<<"warning: feature \""<<kv.first<<"\" is '"<<kv.second
-                        <<"'"<<endl;
-            }
-    }
-    for (const auto& dp : tr_data) {
-        if (!isfinite(dp.y))
-            cout<<"warning: y value is '"<<dp.y<<"'"<<endl;
-        for (const auto& kv : dp.x)
-            if (!isfinite(kv.second)) {
-                cout<<"warning: feature \""<<kv.first<<"\" is '"<<kv.second
-                        <<"'"<<endl;
-            }
-    }
+    for (const bool cv : {true, false})
+        for (size_t i=0; i<numDataPoints(cv); ++i) {
+            if (!isfinite(y(cv, i)))
+                cout<<"warning: y value is '"<<y(cv, i)<<"'"<<endl;
+            forEachFeature(cv, i, [](const string& feat, double v) {
+                if (!isfinite(v))
+                    cout<<"warning: feature \""<<feat<<"\" is '"<<v<<"'"
+                            <<endl;
+            });
+        }
+}
+
+vector<string> LassoRegression::columns() const {
+    set<string> stations, plain;
+    for (const auto* fdata : {&tr_fdata, &cv_fdata})
+        for (const auto& dp : *fdata)
+            stations.insert(dp.station);
+    for (const auto* data : {&tr_data, &cv_data})
+        for (const auto& dp : *data)
+            for (const auto& kv : dp.x)
+                plain.insert(kv.first);
+    vector<string> cols;
+    if (!stations.empty())
+        cols=FeatureRegistry::featureNames(vector<string>(stations.begin(),
+                stations.end()));
+    cols.insert(cols.end(), plain.begin(), plain.end());
+    return cols;
 }
 
+// needs the indices (see updateIndices)
 void LassoRegression::computeNormMinMax() {
-    const auto featset=featureSet();
-    unordered_map<string, vector<double>> featvals;
-    for (const auto& dp : cv_data)
-        for (const auto& feat : featset)
-            if (dp.x.count(feat)==1)
-                featvals[feat].push_back(dp.x.at(feat));
-            else
-                featvals[feat].push_back(0);
-    for (const auto& dp : tr_data)
-        for (const auto& feat : featset)
-            if (dp.x.count(feat)==1)
-                featvals[feat].push_back(dp.x.at(feat));
-            else
-                featvals[feat].push_back(0);
-    for (const auto& kv : featvals) {
-        norm_min[kv.first]=*min_element(kv.second.begin(), kv.second.end());
-        norm_max[kv.first]=*max_element(kv.second.begin(), kv.second.end());
-        if (norm_max[kv.first]-norm_min[kv.first]<=0) {
-            cout<<"warning: feature \""<<kv.first<<"\":"<<endl;
+    const size_t n=numDataPoints(true)+numDataPoints(false);
+    // features missing in a data point count as 0
+    unordered_map<string, size_t> present;
+    for (const bool cv : {true, false})
+        for (size_t i=0; i<numDataPoints(cv); ++i)
+            forEachFeature(cv, i, [&](const string& feat, double v) {
+                if (present[feat]++==0)
+                    norm_min[feat]=norm_max[feat]=v;
+                else {
+                    norm_min[feat]=min(norm_min[feat], v);
+                    norm_max[feat]=max(norm_max[feat], v);
+                }
+            });
+    for (const auto& feat : idx_to_feat) {
+        if (present[feat]==0) {     // e.g. never applies: column of zeros
+            norm_min[feat]=0;
+            norm_max[feat]=1;
+            continue;
+        }
+        if (present[feat]<n) {
+            norm_min[feat]=min(norm_min[feat], 0.0);
+            norm_max[feat]=max(norm_max[feat], 0.0);
+        }
+        if (norm_max[feat]-norm_min[feat]<=0) {
+            cout<<"warning: feature \""<<feat<<"\":"<<endl;
             cout<<"         invalid 0-1 normalization parameters:  min: "
-                    <<norm_min[kv.first]<<" ,  max: "<<norm_max[kv.first]<<endl;
+                    <<norm_min[feat]<<" ,  max: "<<norm_max[feat]<<endl;
             cout<<"         resetting to min=0 and max=1"<<endl;
-            norm_min[kv.first]=0;
-            norm_max[kv.first]=1;
+            norm_min[feat]=0;
+            norm_max[feat]=1;
         }
     }
 }
@@ -68,31 +85,32 @@ void LassoRegression::exportCSV(const string& csvfile) const {
     cout<<"exporting regression model to "<<csvfile<<" ..."<<endl;
     ofstream csv(csvfile);
     csv<<setprecision(15);
-    const auto featset=featureSet();
-    for (const auto& feat : featset)
-        csv<<feat<<",";
-    csv<<"y"<<endl;
-    for (const auto& dp : cv_data) {
-        for (const auto& feat : featset)
-            csv<<(dp.x.count(feat)==1 ? to_string(dp.x.at(feat)) : "0")<<",";
-        csv<<dp.y<<endl;
-    }
-    for (const auto& dp : tr_data) {
-        for (const auto& feat : featset)
-            csv<<(dp.x.count(feat)==1 ? to_string(dp.x.at(feat)) : "0")<<",";
-        csv<<dp.y<<endl;
+    const auto cols=columns();
+    unordered_map<string, size_t> col;
+    for (size_t c=0; c<cols.size(); ++c) {
+        col.insert({cols[c], c});
+        csv<<cols[c]<<",";
     }
+    csv<<"y"<<endl;
+    vector<double> x(cols.size());
+    for (const bool cv : {true, false})
+        for (size_t i=0; i<numDataPoints(cv); ++i) {
+            fill(x.begin(), x.end(), 0);
+            forEachFeature(cv, i, [&](const string& feat, double v) {
+                x[col.at(feat)]=v;
+            });
+            for (const auto v : x)
+                csv<<v<<",";
+            csv<<y(cv, i)<<endl;
+        }
 }
 
-unordered_set<string> LassoRegression::featureSet() const {
-    unordered_set<string> featset;
-    for (const auto& dp : cv_data)
-        for (const auto& kv : dp.x)
-            featset.insert(kv.first);
-    for (const auto& dp : tr_data)
-        for (const auto& kv : dp.x)
-            featset.insert(kv.first);
-    return featset;
+const vector<string>& LassoRegression::layout(const string& station) const {
+    auto it=layouts.find(station);
+    if (it==layouts.end())
+        it=layouts.insert({station, FeatureRegistry::featureNames(station)})
+                .first;
+    return it->second;
 }
 
 double LassoRegression::predict(const unordered_map<string, double>& x) const {
@@ -101,7 +119,18 @@ double LassoRegression::predict(const unordered_map<string, double>& x) const {
     double pred=beta_0;
     for (const auto& kv : x)
         if (beta.count(kv.first)==1)
-            pred+=beta.at(kv.first)*normalize(kv);
+            pred+=beta.at(kv.first)*normalize(kv.first, kv.second);
+    return pred;
+}
+
+double LassoRegression::predict(bool cv, size_t i) const {
+    if (beta.empty())
+        return numeric_limits<double>::max();
+    double pred=beta_0;
+    forEachFeature(cv, i, [&](const string& feat, double v) {
+        if (beta.count(feat)==1)
+            pred+=beta.at(feat)*normalize(feat, v);
+    });
     return pred;
 }
 
@@ -130,15 +159,29 @@ void LassoRegression::save() {
         cout<<"warning: master model not set"<<endl;
 }
 
+LassoRegression::Schema LassoRegression::schema(const vector<string>& names)
+        const {
+    Schema sch;
+    for (size_t k=0; k<names.size(); ++k)
+        if (beta.count(names[k])==1) {
+            sch.slots.push_back(k);
+            sch.beta.push_back(beta.at(names[k]));
+            sch.min.push_back(norm_min.at(names[k]));
+            sch.range.push_back(norm_max.at(names[k])-norm_min.at(names[k]));
+        }
+    return sch;
+}
+
 void LassoRegression::solve(const double l1_ini) {
     // parameters
     const double l1_sm=1.07;            // step multiplier
     cout<<"lasso: setting up data ..."<<endl;
     checkData();
-    computeNormMinMax();
     updateIndices();
-    cout<<"lasso: "<<tr_data.size()<<" training data points ;  "<<cv_data.size()
-            <<" CV data points ;  "<<feat_to_idx.size()<<" features"<<endl;
+    computeNormMinMax();
+    cout<<"lasso: "<<numDataPoints(false)<<" training data points ;  "
+            <<numDataPoints(true)<<" CV data points ;  "<<feat_to_idx.size()
+            <<" features"<<endl;
     Stopwatch sw;
     cout<<"tuning l1 coefficient by cross validation"<<endl;
     double min_err=numeric_limits<double>::max();
@@ -178,20 +221,16 @@ void LassoRegression::solve(const double l1_ini) {
 
 void LassoRegression::solveAllData(double l1) {
     cout<<"solving for l1="<<l1<<" (all data)"<<endl;
-    arma::mat X(tr_data.size()+cv_data.size(), feat_to_idx.size(),
-            arma::fill::zeros);
-    arma::rowvec Y(tr_data.size()+cv_data.size(), arma::fill::zeros);
-    for (size_t i=0; i<tr_data.size(); ++i) {
-        const auto& dp=tr_data[i];
-        for (const auto& kv : dp.x)
-            X(i, feat_to_idx.at(kv.first))=normalize(kv);
-        Y(i)=dp.y;
-    }
-    for (size_t i=0; i<cv_data.size(); ++i) {
-        const auto& dp=cv_data[i];
-        for (const auto& kv : dp.x)
-            X(i+tr_data.size(), feat_to_idx.at(kv.first))=normalize(kv);
-        Y(i+tr_data.size())=dp.y;
+    const size_t n_tr=numDataPoints(false), n_cv=numDataPoints(true);
+    arma::mat X(n_tr+n_cv, feat_to_idx.size(), arma::fill::zeros);
+    arma::rowvec Y(n_tr+n_cv, arma::fill::zeros);
+    for (size_t i=0; i<n_tr+n_cv; ++i) {
+        const bool cv=i>=n_tr;
+        const size_t j=cv ? i-n_tr : i;
+        forEachFeature(cv, j, [&](const string& feat, double v) {
+            X(i, feat_to_idx.at(feat))=normalize(feat, v);
+        });
+        Y(i)=y(cv, j);
     }
     cout<<"covariates matrix populated:  "<<X.n_rows<<" rows,  "<<X.n_cols
             <<" columns,  "<<arma::accu(X!=0)<<" nonzeros"<<endl;
@@ -225,15 +264,10 @@ void LassoRegression::solveAllData(double l1) {
     lars->Predict(X, predY, true);
     double loss=0;
     for (size_t i=0; i<predY.n_cols; ++i) {
-        if (i<tr_data.size()) {
-            if (abs(predY(i)-predict(tr_data.at(i).x))>1e-6
-                    || abs(Y(i)-tr_data.at(i).y)>1e-6)
-                cout<<"warning: values mismatching"<<endl;
-        } else {
-            if (abs(predY(i)-predict(cv_data.at(i-tr_data.size()).x))>1e-6
-                    || abs(Y(i)-cv_data.at(i-tr_data.size()).y)>1e-6)
-                cout<<"warning: values mismatching"<<endl;
-        }
+        const bool cv=i>=n_tr;
+        const size_t j=cv ? i-n_tr : i;
+        if (abs(predY(i)-predict(cv, j))>1e-6 || abs(Y(i)-y(cv, j))>1e-6)
+            cout<<"warning: values mismatching"<<endl;
         double diff=predY(i)-Y(i);
         loss+=diff*diff;
     }
@@ -243,24 +277,25 @@ void LassoRegression::solveAllData(double l1) {
 
 pair<double, double> LassoRegression::solveL1withCV(const double l1) {
     double totcvloss=0, tottrloss=0;
+    const size_t n_tr=numDataPoints(false), n_cv=numDataPoints(true);
     // matrix for training
-    arma::mat X_tr(tr_data.size(), feat_to_idx.size(), arma::fill::zeros);
+    arma::mat X_tr(n_tr, feat_to_idx.size(), arma::fill::zeros);
     // matrix for CV
-    arma::mat X_cv(cv_data.size(), feat_to_idx.size(), arma::fill::zeros);
+    arma::mat X_cv(n_cv, feat_to_idx.size(), arma::fill::zeros);
     // Y vectors for training and CV
-    arma::rowvec Y_tr(tr_data.size(), arma::fill::zeros);
-    arma::rowvec Y_cv(cv_data.size(), arma::fill::zeros);
-    for (size_t i=0; i<tr_data.size(); ++i) {
-        const auto& dp=tr_data[i];
-        for (const auto& kv : dp.x)
-            X_tr(i, feat_to_idx.at(kv.first))=normalize(kv);
-        Y_tr(i)=dp.y;
+    arma::rowvec Y_tr(n_tr, arma::fill::zeros);
+    arma::rowvec Y_cv(n_cv, arma::fill::zeros);
+    for (size_t i=0; i<n_tr; ++i) {
+        forEachFeature(false, i, [&](const string& feat, double v) {
+            X_tr(i, feat_to_idx.at(feat))=normalize(feat, v);
+        });
+        Y_tr(i)=y(false, i);
     }
-    for (size_t i=0; i<cv_data.size(); ++i) {
-        const auto& dp=cv_data[i];
-        for (const auto& kv : dp.x)
-            X_cv(i, feat_to_idx.at(kv.first))=normalize(kv);
-        Y_cv(i)=dp.y;
+    for (size_t i=0; i<n_cv; ++i) {
+        forEachFeature(true, i, [&](const string& feat, double v) {
+            X_cv(i, feat_to_idx.at(feat))=normalize(feat, v);
+        });
+        Y_cv(i)=y(true, i);
     }
     using namespace mlpack::regression;
     LARS lars(X_tr, Y_tr, false, false, l1);
@@ -294,7 +329,7 @@ pair<double, double> LassoRegression::solveL1withCV(const double l1) {
     {   // in-sample error
         arma::rowvec predY;
         lars.Predict(X_tr, predY, true);
-        if (predY.n_cols!=tr_data.size())
+        if (predY.n_cols!=n_tr)
             cout<<"warning: dimensions not matching"<<endl;
         double loss=0;
         for (size_t j=0; j<predY.n_cols; ++j) {
@@ -306,7 +341,7 @@ pair<double, double> LassoRegression::solveL1withCV(const double l1) {
     {   // cross validation error
         arma::rowvec predY;
         lars.Predict(X_cv, predY, true);
-        if (predY.n_cols!=cv_data.size())
+        if (predY.n_cols!=n_cv)
             cout<<"warning: dimensions not matching"<<endl;
         double loss=0;
         for (size_t j=0; j<predY.n_cols; ++j) {
@@ -321,17 +356,9 @@ pair<double, double> LassoRegression::solveL1withCV(const double l1) {
 void LassoRegression::updateIndices() {
     if (feat_to_idx.size()!=idx_to_feat.size())
         cout<<"warning: sizes of indices differ"<<endl;
-    for (const auto& dp : tr_data)
-        for (const auto& kv : dp.x)
-            if (feat_to_idx.count(kv.first)==0) {
-                feat_to_idx.insert({kv.first, idx_to_feat.size()});
-                idx_to_feat.push_back(kv.first);
-            }
-    for (const auto& dp : cv_data)
-        for (const auto& kv : dp.x)
-            if (feat_to_idx.count(kv.first)==0) {
-                feat_to_idx.insert({kv.first, idx_to_feat.size()});
-                idx_to_feat.push_back(kv.first);
-            }
+    for (const auto& feat : columns())
+        if (feat_to_idx.count(feat)==0) {
+            feat_to_idx.insert({feat, idx_to_feat.size()});
+            idx_to_feat.push_back(feat);
+        }
 }
-
@@ -5,13 +5,24 @@
 #include <iostream>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 #include <boost/serialization/serialization.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
+#include "FeatureRegistry.h"
 
 class Model;
 class LassoRegression {
     friend class boost::serialization::access;
+    public:
+        // model coefficients resolved against a fixed list of feature names
+        // (dense feature vectors); features not in the model are left out
+        class Schema {
+            public:
+                std::vector<size_t> slots;      // positions in feature vector
+                std::vector<double> beta, min, range;
+        };
     private:
         class DataPoint {
             friend class boost::serialization::access;
@@ -28,7 +39,33 @@ class LassoRegression {
                     ar & y;
                 }
         };
+        // evaluation model data point: the basis expansion (station and
+        // route interactions, see FeatureRegistry) is not stored but built
+        // on the fly from the sequence and route features
+        class FactoredDataPoint {
+            friend class boost::serialization::access;
+            private:
+                FactoredDataPoint() {}      // for serialization
+            public:
+                std::string station;
+                std::vector<double> sf, rt;
+                double y;
+                FactoredDataPoint(std::string st, std::vector<double> sf_,
+                        std::vector<double> rt_, double y_) : station{std::move(
+                        st)}, sf{std::move(sf_)}, rt{std::move(rt_)}, y{y_} {}
+                template<class Archive> void serialize(Archive& ar,
+                        const unsigned int version) {
+                    ar & station;
+                    ar & sf;
+                    ar & rt;
+                    ar & y;
+                }
+        };
         std::vector<DataPoint> tr_data, cv_data;
+        std::vector<FactoredDataPoint> tr_fdata, cv_fdata;
+        // feature names of the expanded factored data points, per station
+        mutable std::unordered_map<std::string, std::vector<std::string>>
+                layouts;
         std::unordered_map<std::string, size_t> feat_to_idx;
         std::vector<std::string> idx_to_feat;
         std::unordered_map<std::string, double> norm_min, norm_max;
@@ -36,12 +73,42 @@ class LassoRegression {
         std::unordered_map<std::string, double> beta;
         Model* mastermodel=nullptr;
         void checkData() const;
+        // the registry layout (FeatureRegistry::featureNames) over the
+        // stations of the factored data points in name order, then the
+        // features of plain data points in name order
+        std::vector<std::string> columns() const;
         void computeNormMinMax();
-        std::unordered_set<std::string> featureSet() const;
-        double normalize(const std::pair<std::string, double>& kv) const {
-            const auto& feat=kv.first;
-            return (kv.second-norm_min.at(feat))
-                    /(norm_max.at(feat)-norm_min.at(feat));
+        // calls f(name, value) for each feature of data point i (training or
+        // CV set); plain data points come before factored ones
+        template<class F> void forEachFeature(bool cv, size_t i, F f) const {
+            const auto& data=cv ? cv_data : tr_data;
+            if (i<data.size()) {
+                for (const auto& kv : data[i].x)
+                    f(kv.first, kv.second);
+                return;
+            }
+            const auto& dp=(cv ? cv_fdata : tr_fdata)[i-data.size()];
+            const auto& names=layout(dp.station);
+            std::vector<double> x(FeatureRegistry::numFeatures());
+            FeatureRegistry::expand(dp.sf.data(), dp.rt.data(), x.data());
+            for (size_t k=0; k<x.size(); ++k)
+                if (!std::isnan(x[k]))
+                    f(names[k], x[k]);
+        }
+        const std::vector<std::string>& layout(const std::string& station)
+                const;
+        double normalize(const std::string& feat, double v) const {
+            return (v-norm_min.at(feat))/(norm_max.at(feat)-norm_min.at(feat));
+        }
+        size_t numDataPoints(bool cv) const {
+            return cv ? cv_data.size()+cv_fdata.size()
+                    : tr_data.size()+tr_fdata.size();
+        }
+        double predict(bool cv, size_t i) const;
+        double y(bool cv, size_t i) const {
+            const auto& data=cv ? cv_data : tr_data;
+            return i<data.size() ? data[i].y
+                    : (cv ? cv_fdata : tr_fdata)[i-data.size()].y;
         }
         void printBeta() const;
         void solveAllData(double l1);
@@ -57,6 +124,10 @@ class LassoRegression {
             ar & norm_max;
             ar & beta_0;
             ar & beta;
+            if (version>0) {
+                ar & tr_fdata;
+                ar & cv_fdata;
+            }
         }
     public:
         void addDataPoint(std::unordered_map<std::string, double> x, double y,
@@ -77,15 +148,37 @@ class LassoRegression {
             else
                 tr_data.emplace_back(std::move(x), y);
         }
-        void clearData() {tr_data.clear(), cv_data.clear();}
+        // sf/rt: sequence/route features as in FeatureRegistry
+        void addDataPoint(std::string station, std::vector<double> sf,
+                std::vector<double> rt, double y, bool cv) {
+            if (!std::isfinite(y)) {
+                std::cout<<"warning: y value is '"<<y<<"', ignoring data point"
+                        <<std::endl;
+                return;
+            }
+            if (cv)
+                cv_fdata.emplace_back(std::move(station), std::move(sf),
+                        std::move(rt), y);
+            else
+                tr_fdata.emplace_back(std::move(station), std::move(sf),
+                        std::move(rt), y);
+        }
+        void clearData() {
+            tr_data.clear(), cv_data.clear();
+            tr_fdata.clear(), cv_fdata.clear();
+        }
+        bool empty() const {return beta.empty();}
         void exportCSV(const std::string& csvfile) const;
-        size_t numCVDataPoints() const {return cv_data.size();}
-        size_t numTrainingDataPoints() const {return tr_data.size();}
+        double intercept() const {return beta_0;}
+        size_t numCVDataPoints() const {return numDataPoints(true);}
+        size_t numTrainingDataPoints() const {return numDataPoints(false);}
         double predict(const std::unordered_map<std::string, double>& x) const;
+        Schema schema(const std::vector<std::string>& names) const;
         void setMasterModel(Model* m) {mastermodel=m;}
         void save();
         void solve(const double l1_ini);
 };
 
-#endif
+BOOST_CLASS_VERSION(LassoRegression, 1)
 
+#endif
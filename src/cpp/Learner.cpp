@@ -5,16 +5,18 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
-#include <random>
 #include <unordered_set>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/functional/hash.hpp>
 #include "AlgoInput.h"
 #include "Algorithm.h"
 #include "DatasetBuilder.h"
+#include "FeatureRegistry.h"
 #include "JSONParser.h"
 #include "LassoRegression.h"
 #include "Learner.h"
+#include "Random.h"
+#include "SequenceEvaluator.h"
 #include "Statistics.h"
 #include "Stopwatch.h"
 
@@ -111,8 +113,7 @@ vector<pair<vector<string>, vector<int>>> Learner::createBatches(
             cv_ratio);
     cout<<"splitting training data ("<<trndata.size()
             <<" high score routes) into "<<nbatches<<" batches ..."<<endl;
-    random_device rd;
-    mt19937 g(rd());
+    auto g=Random::stream("", Random::Purpose::batches);
     shuffle(trndata.begin(), trndata.end(), g);
     vector<pair<vector<string>, vector<int>>> batches(nbatches);
     for (size_t i=0; i<trndata.size(); ++i) {
@@ -332,15 +333,23 @@ void Learner::learnEvaluationModel() {
         size_t nroute=0;
         for (size_t ridx=0; ridx<routes.size(); ++ridx) {
             const auto& r=routes[ridx];
-            auto seqs=alg->findSequences(psize, r, algoI);
-            for (auto& seq : seqs)
-                r.setupSimilarity(seq, algoI.pattern());
-            sort(seqs.begin(), seqs.end(), Algorithm::better);
-            auto stats=Sequence::statistics(seqs);
-            for (size_t i=0; i<seqs.size()&&i<dps_per_route; ++i) {
-                double sc=allroutes.at(r.id()).computeScore(seqs[i]);
+            auto pool=alg->findSequences(psize, r, algoI);
+            SequenceEvaluator ev(pool.route(), algoI.pattern());
+            for (const auto i : pool.rows())
+                pool.evaluate(i, ev);
+            pool.sort([&pool](size_t i, size_t j)
+                    {return Algorithm::better(pool, i, j);});
+            auto stats=pool.statistics();
+            vector<double> rt(FeatureRegistry::RT_N);
+            FeatureRegistry::routeFeatures(r, stats, rt.data());
+            for (size_t i=0; i<pool.size()&&i<dps_per_route; ++i) {
+                const auto seq=pool.sequence(pool.rows()[i]);
+                double sc=allroutes.at(r.id()).computeScore(seq);
                 bool cv=batches[b].second[ridx]==1;     // cross validation?
-                evlmodel.addDataPoint(seqs[i].features(r, stats), sc, cv);
+                vector<double> sf(FeatureRegistry::SQ_N);
+                FeatureRegistry::sequenceFeatures(seq, stats, rt.data(),
+                        sf.data());
+                evlmodel.addDataPoint(r.station(), move(sf), rt, sc, cv);
             }
             cout<<++nroute<<"/"<<routes.size()<<" routes done"<<endl;
         }
@@ -1,10 +1,168 @@
 #include <algorithm>
+#include "DenseRoute.h"
 #include "LocalSearch.h"
 #include "Route.h"
 #include "Sequence.h"
+#include "SequencePool.h"
+#include "TimingEvaluator.h"
+#include "TimingSummary.h"
 
 using namespace std;
 
+static const double eps=1e-6;      // minimal improvement of a move
+
+// moves segment [s,s+len) between positions x and x+1
+static void moveSegment(size_t* t, size_t s, size_t len, size_t x,
+        bool reversed) {
+    if (x<s) {
+        rotate(t+x+1, t+s, t+s+len);
+        if (reversed)
+            reverse(t+x+1, t+x+1+len);
+    } else {
+        rotate(t+s, t+s+len, t+x+1);
+        if (reversed)
+            reverse(t+x+1-len, t+x+1);
+    }
+}
+
+LocalSearch::LocalSearch(const DenseRoute& r, size_t nk) : dr(r), n{r.size()},
+        k{n>2 ? min(nk, n-2) : 0}, succs(n*k), preds(n*k), tour(n), pos(n),
+        fwd(n), bwd(n), dontlook(n), stopsum(n), presum(n), sufsum(n) {
+    vector<size_t> cands;
+    for (size_t u=0; u<n; ++u) {
+        // the station never moves: no candidate
+        cands.clear();
+        for (size_t v=0; v<n; ++v)
+            if (v!=u && v!=dr.station())
+                cands.push_back(v);
+        partial_sort(cands.begin(), cands.begin()+k, cands.end(),
+                [this, u](size_t a, size_t b) {return cost(u, a)<cost(u, b);});
+        copy(cands.begin(), cands.begin()+k, succs.begin()+u*k);
+        partial_sort(cands.begin(), cands.begin()+k, cands.end(),
+                [this, u](size_t a, size_t b) {return cost(a, u)<cost(b, u);});
+        copy(cands.begin(), cands.begin()+k, preds.begin()+u*k);
+    }
+}
+
+void LocalSearch::activate(size_t u) {
+    if (dontlook[u]) {
+        dontlook[u]=0;
+        active.push_back(u);
+    }
+}
+
+void LocalSearch::applyOrOpt(size_t s, size_t len, size_t x, bool reversed) {
+    activate(tour[s-1]);
+    activate(tour[s]);
+    activate(tour[s+len-1]);
+    activate(tour[s+len]);
+    activate(tour[x]);
+    activate(tour[x+1]);
+    moveSegment(tour.data(), s, len, x, reversed);
+    // positions that change
+    if (x<s)
+        refresh(x+1, s+len-1);
+    else
+        refresh(s, x);
+}
+
+void LocalSearch::applyTwoOpt(size_t i, size_t j) {
+    activate(tour[i-1]);
+    activate(tour[i]);
+    activate(tour[j]);
+    activate(tour[j+1]);
+    reverse(tour.begin()+i, tour.begin()+j+1);
+    refresh(i, j);
+}
+
+double LocalSearch::cost(size_t i, size_t j) const {
+    return dr.travelTime(i, j);
+}
+
+double LocalSearch::exactCost() const {
+    return TimingEvaluator::timing(dr, trial.data(), n).cost();
+}
+
+bool LocalSearch::improveOrOpt(size_t u) {
+    const size_t p=pos[u];
+    for (size_t len=1; len<=3; ++len)
+        for (size_t e=0; e<(len==1 ? 1 : 2); ++e) {
+            // segment [s,s+len) starting (e=0) or ending (e=1) at u
+            if (e==1 && p+1<len)
+                continue;
+            const size_t s=e==0 ? p : p+1-len;
+            if (s<2 || s+len>n-1)
+                continue;
+            const size_t f=tour[s], l=tour[s+len-1];
+            const double gain=cost(tour[s-1], f)+cost(l, tour[s+len])
+                    -cost(tour[s-1], tour[s+len]);
+            const double rev=reversalDelta(s, s+len-1);
+            // insertion points: before a successor of l (f if reversed) or
+            // after a predecessor of f (l if reversed); lists are sorted, so
+            // a list is left once its new arc doesn't beat the removal gain
+            const size_t* cands[4]={&succs[l*k], &preds[f*k], &succs[f*k],
+                    &preds[l*k]};
+            const size_t ends[4]={l, f, f, l};
+            bool live[4]={true, true, len>1, len>1};
+            for (size_t c=0; c<k && (live[0] || live[1] || live[2] || live[3]);
+                    ++c)
+                for (size_t m=0; m<4; ++m) {
+                    if (!live[m])
+                        continue;
+                    const size_t v=cands[m][c];
+                    if ((m%2==0 ? cost(ends[m], v) : cost(v, ends[m]))>=gain) {
+                        live[m]=false;
+                        continue;
+                    }
+                    const size_t x=m%2==0 ? pos[v]-1 : pos[v];
+                    if (x<1 || x>n-2 || (x+1>=s && x<s+len))
+                        continue;
+                    const bool reversed=m>=2;
+                    const double add=reversed
+                            ? cost(tour[x], l)+cost(f, tour[x+1])+rev
+                            : cost(tour[x], f)+cost(l, tour[x+1]);
+                    if (add-cost(tour[x], tour[x+1])-gain<-eps) {
+                        applyOrOpt(s, len, x, reversed);
+                        return true;
+                    }
+                }
+        }
+    return false;
+}
+
+// reversing [i,j] replaces arcs t[i-1]->t[i], t[j]->t[j+1] by t[i-1]->t[j],
+// t[i]->t[j+1]; u is tried as each endpoint of a new arc to a candidate, as
+// long as the new arc is shorter than the arc it replaces at u
+bool LocalSearch::improveTwoOpt(size_t u) {
+    const size_t p=pos[u];
+    const size_t* t=tour.data();
+    const double out=p+1<n ? cost(u, t[p+1]) : 0;
+    const double in=p>0 ? cost(t[p-1], u) : 0;
+    for (size_t c=0; c<k; ++c) {
+        const size_t v=succs[u*k+c], w=preds[u*k+c];
+        const bool vlive=cost(u, v)<out, wlive=cost(w, u)<in;
+        if (!vlive && !wlive)
+            break;
+        // segments [i,j] for new arcs u->v (u=t[i-1] or u=t[i]) and w->u
+        // (w=t[i-1] or w=t[i])
+        const size_t is[4]={p+1, p, pos[w]+1, pos[w]};
+        const size_t js[4]={pos[v], pos[v]-1, p, p-1};
+        for (size_t m=0; m<4; ++m) {
+            const size_t i=is[m], j=js[m];
+            if (!(m<2 ? vlive : wlive) || i<2 || j<=i || j>n-2)
+                continue;
+            const double delta=cost(t[i-1], t[j])+cost(t[i], t[j+1])
+                    -cost(t[i-1], t[i])-cost(t[j], t[j+1])
+                    +reversalDelta(i, j);
+            if (delta<-eps) {
+                applyTwoOpt(i, j);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 bool LocalSearch::myOpt(Sequence& seq, const Route& r) {
     bool success=false;
     auto& stops=seq.stops();
@@ -35,3 +193,250 @@ bool LocalSearch::myOpt(Sequence& seq, const Route& r) {
     return success;
 }
 
+
+bool LocalSearch::optimize(size_t* t) {
+    if (n<5)        // less than 2 stops between entry and exit
+        return false;
+    tour.assign(t, t+n);
+    fwd[0]=bwd[0]=0;
+    refresh(0, n-1);
+    active.clear();
+    fill(dontlook.begin(), dontlook.end(), 1);
+    // a move can become improving without any of its stops being activated
+    // (e.g. reversal costs, or arcs at a candidate changed): all stops are
+    // queued again until a sweep finds nothing
+    bool success=false, improv=true;
+    while (improv) {
+        improv=false;
+        for (size_t p=1; p<n; ++p)
+            activate(tour[p]);
+        while (!active.empty()) {
+            const size_t u=active.front();
+            active.pop_front();
+            dontlook[u]=1;
+            if (improveTwoOpt(u) || improveOrOpt(u)) {
+                activate(u);
+                improv=true;
+            }
+        }
+        success=success || improv;
+    }
+    if (success)
+        copy(tour.begin(), tour.end(), t);
+    return success;
+}
+
+bool LocalSearch::optimize(SequencePool& pool, size_t i) {
+    if (!optimize(pool.tour(i)))
+        return false;
+    pool.setupTiming(i);
+    return true;
+}
+
+bool LocalSearch::optimizeTiming(size_t* t) {
+    if (n<5)
+        return false;
+    tour.assign(t, t+n);
+    fwd[0]=bwd[0]=0;
+    refresh(0, n-1);
+    refreshTiming();
+    double curr=objective(presum[n-1]);
+    bool success=false, improv=true;
+    while (improv) {
+        improv=false;
+        for (size_t p=2; p<n-1; ++p)
+            while (timingTwoOpt(p, curr) || timingOrOpt(p, curr)
+                    || timingSwap(p, curr))
+                improv=true;
+        success=success || improv;
+    }
+    if (success)
+        copy(tour.begin(), tour.end(), t);
+    return success;
+}
+
+bool LocalSearch::optimizeTiming(SequencePool& pool, size_t i) {
+    if (!optimizeTiming(pool.tour(i)))
+        return false;
+    pool.setupTiming(i);
+    return true;
+}
+
+// positions and prefix sums after positions [from,to] changed
+void LocalSearch::refresh(size_t from, size_t to) {
+    for (size_t p=from; p<=to; ++p)
+        pos[tour[p]]=p;
+    for (size_t p=max<size_t>(from, 1); p<n; ++p) {
+        fwd[p]=fwd[p-1]+cost(tour[p-1], tour[p]);
+        bwd[p]=bwd[p-1]+cost(tour[p], tour[p-1]);
+    }
+}
+
+// summaries of all positions after the tour changed
+void LocalSearch::refreshTiming() {
+    stopsum[0]=presum[0]=stopSummary(tour[0], 0, 0);
+    for (size_t p=1; p<n; ++p) {
+        stopsum[p]=after(presum[p-1], tour[p]);
+        presum[p]=concat(presum[p-1], stopsum[p]);
+    }
+    sufsum[n-1]=stopsum[n-1];
+    for (size_t p=n-1; p>1; --p)
+        sufsum[p-1]=concat(stopsum[p-1], sufsum[p]);
+}
+
+// same neighbourhood as myOpt, but moves are judged on duration, earliness and
+// lateness; the timing of pool row i is updated when the tour improves
+bool LocalSearch::timingOpt(SequencePool& pool, size_t i) {
+    bool success=false;
+    const size_t n=pool.route().size();
+    TimingEvaluator ev(pool.route(), vector<size_t>(pool.tour(i),
+            pool.tour(i)+n));
+    double currcost=ev.timing().cost();
+    bool improv=true;
+    while (improv) {
+        improv=false;
+        for (size_t k=1; k+3<n; ++k) {      // keep 1st and last
+            const double swapcost=ev.evaluateSwap(k+1, k+2).cost();
+            if (swapcost<currcost-1e-9) {
+                ev.applySwap(k+1, k+2);
+                currcost=swapcost;
+                improv=true;
+                success=true;
+                if (k>=3)
+                    k-=3;
+                else
+                    k=0;
+            }
+        }
+    }
+    if (success) {
+        copy(ev.tour().begin(), ev.tour().end(), pool.tour(i));
+        pool.setupTiming(i);
+    }
+    return success;
+}
+
+// segments [s,s+len) of 1-3 stops (possibly reversed) are moved between
+// positions x and x+1: stops between the segment and x are appended (x>s) or
+// prepended (x<s) one at a time, so each candidate takes O(len)
+bool LocalSearch::timingOrOpt(size_t s, double& curr) {
+    for (size_t len=1; len<=3 && s+len<n; ++len)
+        for (size_t r=0; r<(len==1 ? 1 : 2); ++r) {
+            const bool reversed=r==1;
+            // the segment after a summary
+            const auto place=[&](Summary c) -> Summary {
+                for (size_t q=0; q<len; ++q)
+                    c=concat(c, stopsum[reversed ? s+len-1-q : s+q]);
+                return c;
+            };
+            const auto verify=[&](const Summary& c, size_t x) -> bool {
+                double v=objective(c);
+                if (v<curr-eps && !c.exact) {
+                    trial=tour;
+                    moveSegment(trial.data(), s, len, x, reversed);
+                    v=exactCost();
+                }
+                if (v>=curr-eps)
+                    return false;
+                applyOrOpt(s, len, x, reversed);
+                refreshTiming();
+                curr=objective(presum[n-1]);
+                return true;
+            };
+            // later: stops [s+len,x] right after position s-1
+            Summary mid=presum[s-1];
+            for (size_t x=s+len; x<n-1; ++x) {
+                mid=concat(mid, stopsum[x]);
+                if (verify(concat(place(mid), sufsum[x+1]), x))
+                    return true;
+            }
+            // earlier: stops [x+1,s-1] after the segment
+            if (s<3)
+                continue;
+            Summary back=stopsum[s-1];
+            for (size_t x=s-2; x>=1; --x) {
+                if (verify(concat(concat(place(presum[x]), back),
+                        sufsum[s+len]), x))
+                    return true;
+                back=concat(stopsum[x], back);
+            }
+        }
+    return false;
+}
+
+// stops i and j>i exchange positions; the stops in between are appended one
+// at a time
+bool LocalSearch::timingSwap(size_t i, double& curr) {
+    Summary mid;
+    for (size_t j=i+1; j<n-1; ++j) {
+        Summary c=concat(presum[i-1], stopsum[j]);
+        if (j>i+1) {
+            mid=j==i+2 ? stopsum[i+1] : concat(mid, stopsum[j-1]);
+            c=concat(c, mid);
+        }
+        c=concat(concat(c, stopsum[i]), sufsum[j+1]);
+        double v=objective(c);
+        if (v<curr-eps && !c.exact) {
+            trial=tour;
+            swap(trial[i], trial[j]);
+            v=exactCost();
+        }
+        if (v<curr-eps) {
+            swap(tour[i], tour[j]);
+            refresh(i, j);
+            refreshTiming();
+            curr=objective(presum[n-1]);
+            return true;
+        }
+    }
+    return false;
+}
+
+// reversing [i,j]: the reversed segment grows by stop j in front, at its
+// exact time after position i-1; if that shifts a stop of the segment across
+// a time window bound, the segment is rebuilt stop by stop
+bool LocalSearch::timingTwoOpt(size_t i, double& curr) {
+    Summary rev=after(presum[i-1], tour[i]);
+    for (size_t j=i+1; j<n-1; ++j) {
+        rev=concat(after(presum[i-1], tour[j]), rev);
+        if (!rev.exact) {
+            rev=after(presum[i-1], tour[j]);
+            for (size_t q=j; q-->i;)
+                rev=concat(rev, stopsum[q]);
+        }
+        const Summary c=concat(concat(presum[i-1], rev), sufsum[j+1]);
+        double v=objective(c);
+        if (v<curr-eps && !c.exact) {
+            trial=tour;
+            reverse(trial.begin()+i, trial.begin()+j+1);
+            v=exactCost();
+        }
+        if (v<curr-eps) {
+            applyTwoOpt(i, j);
+            refreshTiming();
+            curr=objective(presum[n-1]);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LocalSearch::zoneOpt(size_t* tour) {
+    const auto nano=DenseRoute::Level::nano;
+    bool success=false;
+    for (size_t a=1, b; a<n; a=b) {     // runs [a,b); the station is kept
+        const int z=dr.zone(nano, tour[a]);
+        for (b=a+1; b<n && dr.zone(nano, tour[b])==z; ++b)
+            ;
+        if (z!=0 && hk.optimize(dr, tour+a, b-a))   // 0: unknown zone
+            success=true;
+    }
+    return success;
+}
+
+bool LocalSearch::zoneOpt(SequencePool& pool, size_t i) {
+    if (!zoneOpt(pool.tour(i)))
+        return false;
+    pool.setupTiming(i);
+    return true;
+}
@@ -1,12 +1,82 @@
 #ifndef localsearch_h
 #define localsearch_h
 
+#include <deque>
+#include <vector>
+#include "HeldKarp.h"
+#include "TimingSummary.h"
+
+class DenseRoute;
 class Route;
 class Sequence;
+class SequencePool;
+// travel time local search over dense stop indices: 2-opt (asymmetric costs,
+// segment costs from forward/backward prefix sums) and Or-opt of segments of
+// 1-3 stops, possibly reversed (1 stop = relocate); moves are only tried
+// towards the k nearest successors/predecessors of a stop and stops whose
+// neighbourhood didn't improve are skipped until one of their arcs changes
+// (don't-look bits); the station, entry (position 1) and exit (last) are kept
 class LocalSearch {
+    private:
+        typedef TimingSummary Summary;
+        const DenseRoute& dr;
+        const size_t n, k;
+        std::vector<size_t> succs, preds;   // n x k nearest (by travel time)
+        // workspace
+        std::vector<size_t> tour, pos;
+        std::vector<double> fwd, bwd;   // prefix sums of tour arcs (reversed)
+        std::deque<size_t> active;
+        std::vector<char> dontlook;
+        HeldKarp hk;
+        // timing search: summaries of each stop, prefix and suffix
+        std::vector<Summary> stopsum, presum, sufsum;
+        std::vector<size_t> trial;
+        void activate(size_t u);
+        Summary after(const Summary& a, size_t s) const
+                {return Summary::after(dr, a, s);}
+        // moves segment [s,s+len) between positions x and x+1
+        void applyOrOpt(size_t s, size_t len, size_t x, bool reversed);
+        void applyTwoOpt(size_t i, size_t j);   // reverses positions [i,j]
+        Summary concat(const Summary& a, const Summary& b) const
+                {return Summary::concat(dr, a, b);}
+        double cost(size_t i, size_t j) const;
+        // duration (back to the station), earliness and lateness of trial
+        double exactCost() const;
+        // cost of positions [i,j] traversed backwards minus forwards
+        double reversalDelta(size_t i, size_t j) const
+                {return bwd[j]-bwd[i]-(fwd[j]-fwd[i]);}
+        bool improveOrOpt(size_t u);
+        bool improveTwoOpt(size_t u);
+        // duration (back to the station), earliness and lateness of a tour
+        double objective(const Summary& s) const {
+            return s.duration+cost(s.last, tour[0])+s.earliness+s.lateness;
+        }
+        void refresh(size_t from, size_t to);
+        void refreshTiming();
+        Summary stopSummary(size_t s, long ae, long al) const
+                {return Summary::stop(dr, s, ae, al);}
+        // apply the first improving move of segments starting at s (i)
+        bool timingOrOpt(size_t s, double& curr);
+        bool timingSwap(size_t i, double& curr);
+        bool timingTwoOpt(size_t i, double& curr);
     public:
+        LocalSearch(const DenseRoute& r, size_t nk=8);
         static bool myOpt(Sequence& seq, const Route& r);
+        // tour: station first, n stops
+        bool optimize(size_t* tour);
+        // the timing of pool row i is updated when the tour improves; the
+        // caller re-keys the row (see SequencePool::retour)
+        bool optimize(SequencePool& pool, size_t i);
+        // 2-opt, Or-opt and swap moves judged on duration, earliness and
+        // lateness (see Summary; moves whose summary isn't exact are checked
+        // with TimingEvaluator); the station, entry and exit are kept
+        bool optimizeTiming(size_t* tour);
+        bool optimizeTiming(SequencePool& pool, size_t i);
+        static bool timingOpt(SequencePool& pool, size_t i);
+        // runs of consecutive stops of the same nano zone are reordered
+        // keeping their first and last stop (see HeldKarp)
+        bool zoneOpt(size_t* tour);
+        bool zoneOpt(SequencePool& pool, size_t i);
 };
 
 #endif
-
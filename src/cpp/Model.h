@@ -9,7 +9,9 @@
 #include <boost/serialization/map.hpp>
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/string.hpp>
+#include <boost/serialization/version.hpp>
 #include "AlgoInput.h"
+#include "FeatureRegistry.h"
 #include "LassoRegression.h"
 
 class Model {
@@ -19,6 +21,7 @@ class Model {
         std::map<std::string, LassoRegression> algmodels;
         LassoRegression evlmodel;
         bool evlmodelset=false;
+        uint64_t schemahash=0;      // feature schema of the evaluation model
         std::string modelfile;
         template<class Archive> void serialize(Archive& ar,
                 const unsigned int version) {
@@ -26,6 +29,21 @@ class Model {
             ar & algmodels;
             ar & evlmodel;
             ar & evlmodelset;
+            if (version>0)
+                ar & schemahash;
+            if (Archive::is_loading::value && evlmodelset) {
+                if (version==0)
+                    std::cout<<"warning: evaluation model without feature "
+                            <<"schema (older model file)"<<std::endl;
+                else if (schemahash!=FeatureRegistry::schemaHash()) {
+                    // its coefficients would land on the wrong features
+                    std::cout<<"warning: evaluation model built with a "
+                            <<"different feature schema, discarding it"
+                            <<std::endl;
+                    evlmodel=LassoRegression();
+                    evlmodelset=false;
+                }
+            }
         }
     public:
         void addAlgorithmModel(std::string id, LassoRegression model) {
@@ -53,8 +71,11 @@ class Model {
         void setEvaluationModel(LassoRegression m) {
             evlmodel=std::move(m);
             evlmodelset=true;
+            schemahash=FeatureRegistry::schemaHash();
         }
 };
 
+BOOST_CLASS_VERSION(Model, 1)
+
 #endif
 
@@ -0,0 +1,29 @@
+#include <random>
+#include "Random.h"
+
+using namespace std;
+
+uint64_t& Random::globalSeed() {
+    static uint64_t s=[](){
+        random_device rd;
+        return (uint64_t(rd())<<32)^rd();
+    }();
+    return s;
+}
+
+// FNV-1a
+uint64_t Random::hash(const string& key) {
+    uint64_t h=0xcbf29ce484222325ull;
+    for (const auto c : key) {
+        h^=static_cast<unsigned char>(c);
+        h*=0x100000001b3ull;
+    }
+    return h;
+}
+
+Random::Stream Random::stream(const string& key, Purpose p, uint64_t index) {
+    uint64_t s=mix(seed()^mix(hash(key)));
+    s=mix(s^mix(static_cast<uint64_t>(p)+1));
+    return Stream(mix(s^mix(index+0x632be59bd9b4e019ull)));
+}
+
@@ -0,0 +1,48 @@
+#ifndef random_h
+#define random_h
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// random number streams derived from one global seed: a stream only depends on
+// the seed, a key (e.g. a route id), a purpose and an index, never on the
+// thread or the order in which streams are created
+class Random {
+    public:
+        // new purposes are appended: existing streams stay the same
+        enum class Purpose {batches, entryExit, guidedTours, orderedTours,
+                randomTours, sampling, hierarchicalTours};
+        // SplitMix64 generator, usable with <random> distributions
+        class Stream {
+            private:
+                uint64_t state;
+            public:
+                typedef uint64_t result_type;
+                explicit Stream(uint64_t s) : state{s} {}
+                static constexpr result_type min() {return 0;}
+                static constexpr result_type max()
+                        {return std::numeric_limits<result_type>::max();}
+                result_type operator()() {
+                    return mix(state+=0x9e3779b97f4a7c15ull);
+                }
+        };
+    private:
+        static uint64_t& globalSeed();
+        // SplitMix64 finalizer
+        static uint64_t mix(uint64_t z) {
+            z=(z^(z>>30))*0xbf58476d1ce4e5b9ull;
+            z=(z^(z>>27))*0x94d049bb133111ebull;
+            return z^(z>>31);
+        }
+    public:
+        static uint64_t hash(const std::string& key);
+        // without setSeed the seed is drawn from std::random_device once
+        static uint64_t seed() {return globalSeed();}
+        static void setSeed(uint64_t s) {globalSeed()=s;}
+        static Stream stream(const std::string& key, Purpose p,
+                uint64_t index=0);
+};
+
+#endif
+
@@ -0,0 +1,148 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_set>
+#include "JSONParser.h"
+#include "Scorer.h"
+#include "Stopwatch.h"
+
+using namespace std;
+using namespace rapidjson;
+
+Scorer::Scorer(const string& traveltimes, const string& propseqs,
+        const string& actualseqs, const string& invalidseqscrs) {
+    cout<<"reading/processing actual sequences ..."<<endl;
+    loadActualSequences(JSONParser::parse(actualseqs));
+    cout<<"reading/processing travel times ..."<<endl;
+    loadTravelTimes(JSONParser::parse(traveltimes));
+    cout<<"reading/processing invalid sequence scores ..."<<endl;
+    loadInvalidSequenceScores(JSONParser::parse(invalidseqscrs));
+    cout<<"reading/processing proposed sequences ..."<<endl;
+    loadProposedSequences(JSONParser::parse(propseqs));
+    cout<<routes.size()<<" routes to score"<<endl;
+}
+
+void Scorer::loadActualSequences(const Document& dom) {
+    for (const auto& route : dom.GetObject()) {
+        const auto& stops=route.value["actual"];
+        vector<string> stopseq(stops.MemberCount());
+        for (const auto& stop : stops.GetObject()) {
+            const int pos=stop.value.GetInt();
+            if (pos<0 || pos>=static_cast<int>(stopseq.size())) {
+                cout<<"warning: stop order out of range"<<endl;
+                continue;
+            }
+            stopseq[pos]=stop.name.GetString();
+        }
+        routeidx.insert({route.name.GetString(), routes.size()});
+        // travel times are set when loaded
+        routes.emplace_back(route.name.GetString(), TTMatrix(0),
+                Sequence(move(stopseq)));
+    }
+}
+
+void Scorer::loadInvalidSequenceScores(const Document& dom) {
+    for (const auto& route : dom.GetObject())
+        if (routeidx.count(route.name.GetString())==1)
+            routes[routeidx.at(route.name.GetString())].costinvalid=
+                    route.value.GetDouble();
+}
+
+void Scorer::loadProposedSequences(const Document& dom) {
+    for (const auto& route : dom.GetObject()) {
+        if (routeidx.count(route.name.GetString())==0) {
+            cout<<"warning: no actual sequence for route "
+                    <<route.name.GetString()<<endl;
+            continue;
+        }
+        auto& rt=routes[routeidx.at(route.name.GetString())];
+        const auto& stops=route.value["proposed"];
+        vector<string> stopseq(stops.MemberCount());
+        bool inrange=true;
+        for (const auto& stop : stops.GetObject()) {
+            const int pos=stop.value.GetInt();
+            if (pos<0 || pos>=static_cast<int>(stopseq.size()))
+                inrange=false;
+            else
+                stopseq[pos]=stop.name.GetString();
+        }
+        if (!inrange)
+            continue;                   // scored as invalid
+        rt.proposed=Sequence(move(stopseq));
+        rt.hasproposed=true;
+    }
+}
+
+void Scorer::loadTravelTimes(const Document& dom) {
+    for (const auto& route : dom.GetObject()) {
+        if (routeidx.count(route.name.GetString())==0)
+            continue;
+        auto& rt=routes[routeidx.at(route.name.GetString())];
+        TTMatrix ttimes(route.value.MemberCount());
+        for (const auto& from : route.value.GetObject()) {
+            auto fromid=from.name.GetString();
+            for (const auto& to : from.value.GetObject())
+                ttimes.setTravelTime(fromid, to.name.GetString(),
+                        to.value.GetDouble());
+        }
+        rt.normtts=ttimes.normalize();
+    }
+}
+
+void Scorer::saveScores(const string& filename) const {
+    ofstream os(filename);
+    os<<setprecision(15);
+    os<<"{"<<endl;
+    os<<"  \"submission_score\": "<<submissionscore<<","<<endl;
+    os<<"  \"route_scores\": {"<<endl;
+    for (size_t i=0; i<routes.size(); ++i)
+        os<<"    \""<<routes[i].id<<"\": "<<routes[i].score
+                <<(i+1<routes.size()?",":"")<<endl;
+    os<<"  },"<<endl;
+    os<<"  \"route_feasibility\": {"<<endl;
+    for (size_t i=0; i<routes.size(); ++i)
+        os<<"    \""<<routes[i].id<<"\": "
+                <<(routes[i].feasible?"true":"false")
+                <<(i+1<routes.size()?",":"")<<endl;
+    os<<"  }"<<endl;
+    os<<"}"<<endl;
+}
+
+double Scorer::score() {
+    Stopwatch sw;
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i=0; i<routes.size(); ++i) {
+        auto& rt=routes[i];
+        rt.feasible=rt.hasproposed && rt.normtts.size()==rt.actual.stops()
+                .size() && valid(rt.proposed, rt.actual);
+        rt.score=rt.feasible ? Sequence::score(rt.normtts, rt.proposed,
+                rt.actual) : rt.costinvalid;
+    }
+    double sum=0;
+    size_t infeasible=0;
+    for (const auto& rt : routes) {
+        sum+=rt.score;
+        if (!rt.feasible)
+            infeasible++;
+    }
+    submissionscore=routes.empty() ? 0 : sum/routes.size();
+    cout<<"submission score: "<<submissionscore<<"  ("<<routes.size()
+            <<" routes, "<<infeasible<<" infeasible, "<<sw.elapsedSeconds()
+            <<" s)"<<endl;
+    return submissionscore;
+}
+
+// same stops as the actual sequence, starting at the station
+bool Scorer::valid(const Sequence& prop, const Sequence& actual) {
+    const auto& pstops=prop.stops();
+    const auto& astops=actual.stops();
+    if (pstops.size()!=astops.size() || pstops.empty()
+            || pstops[0]!=astops[0])
+        return false;
+    unordered_set<string> stops(astops.begin(), astops.end());
+    for (const auto& s : pstops)
+        if (stops.erase(s)==0)
+            return false;
+    return true;
+}
+
@@ -0,0 +1,45 @@
+#ifndef scorer_h
+#define scorer_h
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "rapidjson/document.h"
+#include "Sequence.h"
+#include "TTMatrix.h"
+
+// scores proposed sequences against the actual ones with the measure of the
+// challenge evaluator (see Sequence::score); routes are scored in parallel
+class Scorer {
+    private:
+        class ScoredRoute {
+            public:
+                std::string id;
+                TTMatrix normtts;               // normalized travel times
+                Sequence actual, proposed;
+                bool hasproposed=false;
+                double costinvalid=0;
+                double score=0;
+                bool feasible=false;
+                ScoredRoute(std::string i, TTMatrix tt, Sequence act)
+                        : id{std::move(i)}, normtts{std::move(tt)},
+                        actual{std::move(act)}, proposed({}) {}
+        };
+        std::vector<ScoredRoute> routes;
+        std::unordered_map<std::string, size_t> routeidx;
+        double submissionscore=0;
+        void loadActualSequences(const rapidjson::Document& dom);
+        void loadInvalidSequenceScores(const rapidjson::Document& dom);
+        void loadProposedSequences(const rapidjson::Document& dom);
+        void loadTravelTimes(const rapidjson::Document& dom);
+        static bool valid(const Sequence& prop, const Sequence& actual);
+    public:
+        Scorer(const std::string& traveltimes, const std::string& propseqs,
+                const std::string& actualseqs,
+                const std::string& invalidseqscrs);
+        void saveScores(const std::string& filename) const;
+        double score();
+};
+
+#endif
+
@@ -1,12 +1,158 @@
 #include <algorithm>
+#include <cmath>
 #include <deque>
 #include <iostream>
+#include <limits>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "FeatureRegistry.h"
 #include "Learner.h"
 #include "Sequence.h"
 #include "TestRoute.h"
 
 using namespace std;
 
+// bottom-up over the suffixes actual[i..] and sub[j..], keeping rows i+1 and
+// i of (edit cost, number of edits); ties are broken as in the original
+// recursion (match/substitute, then gap in sub, then gap in actual)
+// with a finite cutoff, the DP is abandoned as soon as a lower bound on the
+// result reaches it (the bound is returned and 'bounded' is set): the optimal
+// path enters row i at some (i,j) after at most i+j steps and then follows
+// the DP, so its cost per edit is at least D(i,j)/(i+j+C(i,j))
+static double erpRows(const vector<size_t>& actual, const vector<size_t>& sub,
+        const TTMatrix& ttimes, const double g,
+        const double cutoff=numeric_limits<double>::infinity(),
+        bool* bounded=nullptr) {
+    const size_t na=actual.size(), ns=sub.size();
+    vector<double> d_next(ns+1), d_curr(ns+1);
+    vector<size_t> c_next(ns+1), c_curr(ns+1);
+    for (size_t j=0; j<=ns; ++j) {      // actual is "empty"
+        d_next[j]=(ns-j)*g;
+        c_next[j]=ns-j;
+    }
+    for (size_t i=na; i-->0;) {
+        d_curr[ns]=(na-i)*g;            // sub is "empty"
+        c_curr[ns]=na-i;
+        for (size_t j=ns; j-->0;) {
+            const double optA=d_next[j+1]+ttimes.travelTime(actual[i], sub[j]);
+            const double optB=d_next[j]+g;
+            const double optC=d_curr[j+1]+g;
+            const double d=min({optA, optB, optC});
+            d_curr[j]=d;
+            if (d==optA)
+                c_curr[j]=actual[i]==sub[j] ? c_next[j+1] : c_next[j+1]+1;
+            else if (d==optB)
+                c_curr[j]=c_next[j]+1;
+            else
+                c_curr[j]=c_curr[j+1]+1;
+        }
+        if (cutoff<numeric_limits<double>::infinity()) {
+            double lb=numeric_limits<double>::max();
+            for (size_t j=0; j<=ns; ++j)       // no edits at all: 0
+                lb=min(lb, i+j+c_curr[j]==0 ? 0
+                        : d_curr[j]/(i+j+c_curr[j]));
+            if (lb>=cutoff) {
+                *bounded=true;
+                return lb;
+            }
+        }
+        d_next.swap(d_curr);
+        c_next.swap(c_curr);
+    }
+    return c_next[0]==0 ? 0 : d_next[0]/c_next[0];
+}
+
+#if defined(__x86_64__)
+// same recursion as erpRows, computed by anti-diagonals: the cells (i,j) with
+// i+j=k only depend on diagonals k+1 and k+2 (indexed by i), so 4 of them are
+// computed at a time; selection and additions are the same as in erpRows
+__attribute__((target("avx2")))
+static double erpWavefront(const vector<size_t>& actual,
+        const vector<size_t>& sub, const TTMatrix& ttimes, const double g) {
+    const size_t na=actual.size(), ns=sub.size();
+    // cost[i*ns+j]: substitution cost; match[i]: position of actual[i] in sub
+    vector<double> cost(na*ns);
+    vector<int64_t> match(na+4, -1);
+    for (size_t i=0; i<na; ++i)
+        for (size_t j=0; j<ns; ++j) {
+            cost[i*ns+j]=ttimes.travelTime(actual[i], sub[j]);
+            if (actual[i]==sub[j])
+                match[i]=j;
+        }
+    // diagonals k, k+1 and k+2 of costs and edit counts (padded for i+1)
+    vector<double> buf(6*(na+5));
+    double* d0=&buf[0];
+    double* d1=&buf[na+5];
+    double* d2=&buf[2*(na+5)];
+    double* c0=&buf[3*(na+5)];
+    double* c1=&buf[4*(na+5)];
+    double* c2=&buf[5*(na+5)];
+    const __m256d vg=_mm256_set1_pd(g), one=_mm256_set1_pd(1.0);
+    const __m256i lane=_mm256_set_epi64x(3, 2, 1, 0);
+    const __m256i stride=_mm256_set1_epi64x(ns-1);
+    for (size_t k=na+ns+1; k-->0;) {
+        if (k>=na && k-na<=ns) {        // actual is "empty"
+            d0[na]=(ns-(k-na))*g;
+            c0[na]=ns-(k-na);
+        }
+        if (k>=ns && k-ns<=na) {        // sub is "empty" (checked last)
+            d0[k-ns]=(na-(k-ns))*g;
+            c0[k-ns]=na-(k-ns);
+        }
+        // interior cells: j=k-i<ns and i<na
+        const size_t lo=k+1>ns ? k+1-ns : 0, hi=min(k+1, na);
+        size_t i=lo;
+        for (; i+4<=hi; i+=4) {
+            const __m256i vi=_mm256_add_epi64(_mm256_set1_epi64x(i), lane);
+            const __m256i vj=_mm256_sub_epi64(_mm256_set1_epi64x(k), vi);
+            // cost[i*ns+k-i]=cost[i*(ns-1)+k]
+            const __m256i idx=_mm256_add_epi64(_mm256_mul_epu32(vi, stride),
+                    _mm256_set1_epi64x(k));
+            const __m256d cst=_mm256_i64gather_pd(cost.data(), idx, 8);
+            const __m256d neq=_mm256_andnot_pd(_mm256_castsi256_pd(
+                    _mm256_cmpeq_epi64(vj, _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(&match[i])))), one);
+            const __m256d optA=_mm256_add_pd(_mm256_loadu_pd(d2+i+1), cst);
+            const __m256d optB=_mm256_add_pd(_mm256_loadu_pd(d1+i+1), vg);
+            const __m256d optC=_mm256_add_pd(_mm256_loadu_pd(d1+i), vg);
+            const __m256d mA=_mm256_and_pd(_mm256_cmp_pd(optA, optB,
+                    _CMP_LE_OQ), _mm256_cmp_pd(optA, optC, _CMP_LE_OQ));
+            const __m256d mB=_mm256_cmp_pd(optB, optC, _CMP_LE_OQ);
+            const __m256d cntA=_mm256_add_pd(_mm256_loadu_pd(c2+i+1), neq);
+            const __m256d cntB=_mm256_add_pd(_mm256_loadu_pd(c1+i+1), one);
+            const __m256d cntC=_mm256_add_pd(_mm256_loadu_pd(c1+i), one);
+            _mm256_storeu_pd(d0+i, _mm256_blendv_pd(_mm256_blendv_pd(optC,
+                    optB, mB), optA, mA));
+            _mm256_storeu_pd(c0+i, _mm256_blendv_pd(_mm256_blendv_pd(cntC,
+                    cntB, mB), cntA, mA));
+        }
+        for (; i<hi; ++i) {
+            const size_t j=k-i;
+            const double optA=d2[i+1]+cost[i*ns+j];
+            const double optB=d1[i+1]+g;
+            const double optC=d1[i]+g;
+            if (optA<=optB && optA<=optC) {
+                d0[i]=optA;
+                c0[i]=match[i]==static_cast<int64_t>(j) ? c2[i+1] : c2[i+1]+1;
+            } else if (optB<=optC) {
+                d0[i]=optB;
+                c0[i]=c1[i+1]+1;
+            } else {
+                d0[i]=optC;
+                c0[i]=c1[i]+1;
+            }
+        }
+        swap(d2, d1);
+        swap(d1, d0);
+        swap(c2, c1);
+        swap(c1, c0);
+    }
+    const size_t count=static_cast<size_t>(c1[0]);
+    return count==0 ? 0 : d1[0]/count;
+}
+#endif
+
 Sequence::Sequence(vector<string> stps) : stops_{move(stps)} {
     for (size_t i=0; i<stops_.size(); ++i)
         stopid_to_idx[stops_[i]]=i;
@@ -36,45 +182,33 @@ int Sequence::distance(const Sequence& s) const {
     return d;
 }
 
-pair<double, size_t> Sequence::erpPerEditHelper(const Seq& actual,
-        size_t h_actual, const Seq& sub, size_t h_sub, const TTMatrix& ttimes,
-        const double g, unordered_map<sizet_pair, pair<double, size_t>,
-        boost::hash<sizet_pair>>& memo) {
-    if (memo.count({h_actual, h_sub})==1)
-        return memo.at({h_actual, h_sub});
-    double d=0;
-    size_t count=0;
-    if (h_sub==sub.size()) {                    // if sub is "empty"
-        d=(actual.size()-h_actual)*g;
-        count=actual.size()-h_actual;
-    } else if (h_actual==actual.size()) {       // if actual is "empty"
-        d=(sub.size()-h_sub)*g;
-        count=sub.size()-h_sub;
-    } else {
-        auto next_actual=h_actual+1;
-        auto next_sub=h_sub+1;
-        auto A=erpPerEditHelper(actual,next_actual,sub,next_sub,ttimes,g,memo);
-        auto B=erpPerEditHelper(actual,next_actual,sub,h_sub,ttimes,g,memo);
-        auto C=erpPerEditHelper(actual,h_actual,sub,next_sub,ttimes,g,memo);
-        auto headactual=actual[h_actual];
-        auto headsub=sub[h_sub];
-        // TODO: make this less obscure (no need to call distErp here)
-        auto optA=A.first+distErp(headactual, headsub, ttimes, g);
-        auto optB=B.first+distErp(headactual, "gap", ttimes, g);
-        auto optC=C.first+distErp(headsub, "gap", ttimes, g);
-        d=min({optA, optB, optC});
-        if (d==optA) {
-            if (headactual==headsub)
-                count=A.second;
-            else
-                count=A.second+1;
-        } else if (d==optB)
-            count=B.second+1;
-        else
-            count=C.second+1;
-    }
-    memo.insert({{h_actual, h_sub}, {d, count}});
-    return {d, count};
+double Sequence::erpPerEdit(const Seq& actual, const Seq& sub,
+        const TTMatrix& ttimes, const double g) {
+    vector<size_t> act, sb;
+    act.reserve(actual.size());
+    sb.reserve(sub.size());
+    for (const auto& s : actual)
+        act.push_back(ttimes.index(s));
+    for (const auto& s : sub)
+        sb.push_back(ttimes.index(s));
+    return erpPerEdit(act, sb, ttimes, g);
+}
+
+double Sequence::erpPerEdit(const vector<size_t>& actual,
+        const vector<size_t>& sub, const TTMatrix& ttimes, const double g,
+        const double cutoff, bool& bounded) {
+    bounded=false;
+    return erpRows(actual, sub, ttimes, g, cutoff, &bounded);
+}
+
+double Sequence::erpPerEdit(const vector<size_t>& actual,
+        const vector<size_t>& sub, const TTMatrix& ttimes, const double g) {
+#if defined(__x86_64__)
+    static const bool avx2=__builtin_cpu_supports("avx2");
+    if (avx2 && actual.size()>=8 && sub.size()>=8)
+        return erpWavefront(actual, sub, ttimes, g);
+#endif
+    return erpRows(actual, sub, ttimes, g);
 }
 
 void Sequence::exportJSON(ofstream& os) const {
@@ -86,169 +220,25 @@ void Sequence::exportJSON(ofstream& os) const {
     }
 }
 
-unordered_map<string, double> Sequence::features(const Route& r,
-        const unordered_map<string, double>& stats) const {
-    if (miss_early==-1 || miss_late==-1)
-        cout<<"warning: sequence early/late arrivals not set"<<endl;
-    if (sim_macro==-1 || sim_micro==-1 || sim_nano==-1)
-        cout<<"warning: sequence similarity not set"<<endl;
-    if (trans_macro<=0 || trans_micro<=0 || trans_nano<=0)
-        cout<<"warning: sequence transitions not set or invalid"<<endl;
-    // route and aggregated features
-    unordered_map<string, double> rtfeats;
-    rtfeats.insert({"p_with_totness", stats.at("p_with_totness")});
-    rtfeats.insert({"p_wout_totness", stats.at("p_wout_totness")});
-    rtfeats.insert({"p_with_out_arrivals", stats.at("p_with_out_arrivals")});
-    rtfeats.insert({"p_wout_out_arrivals", stats.at("p_wout_out_arrivals")});
-    rtfeats.insert({"avg_earliness", stats.at("avg_earliness")});
-    rtfeats.insert({"avg_lateness", stats.at("avg_lateness")});
-    rtfeats.insert({"avg_totness", stats.at("avg_earliness")
-            +stats.at("avg_lateness")});
-    rtfeats.insert({"n_stops", r.stops().size()-1});
-    rtfeats.insert({"n_tws", r.countTimeWindows(0, 361)});
-    rtfeats.insert({"n_strict_tws", r.countTimeWindows(0, 241)});
-    rtfeats.insert({"p_tws", rtfeats.at("n_tws")/rtfeats.at("n_stops")});
-    rtfeats.insert({"p_strict_tws", rtfeats.at("n_strict_tws")
-            /rtfeats.at("n_stops")});
-    rtfeats.insert({"dropoff_nearest", r.distanceNearestDropoff()});
-    rtfeats.insert({"dropoff_area", r.rectangle().area()});
-    rtfeats.insert({"dropoff_density", rtfeats.at("n_stops")
-            /rtfeats.at("dropoff_area")});
-    rtfeats.insert({"n_packs", r.numPackages()});
-    rtfeats.insert({"packs_per_stop", rtfeats.at("n_packs")
-            /rtfeats.at("n_stops")});
-    rtfeats.insert({"service_time", r.serviceTime()});
-    rtfeats.insert({"distinct_macro", r.distinctMacroZones()});
-    rtfeats.insert({"distinct_micro", r.distinctMicroZones()});
-    rtfeats.insert({"distinct_nano", r.distinctNanoZones()});
-    // sequence features
-    unordered_map<string, double> seqfeats;
-    seqfeats.insert({"r_duration", dur/stats.at("min_duration")});
-    seqfeats.insert({"dur_by_stime", dur/rtfeats.at("service_time")});
-    seqfeats.insert({"earliness", earliness_});
-    if (rtfeats.at("avg_earliness")!=0)
-        seqfeats.insert({"r_earliness",earliness_/rtfeats.at("avg_earliness")});
-    seqfeats.insert({"lateness", lateness_});
-    if (rtfeats.at("avg_lateness")!=0)
-        seqfeats.insert({"r_lateness",lateness_/rtfeats.at("avg_lateness")});
-    seqfeats.insert({"totness", earliness_+lateness_});
-    seqfeats.insert({"max_stop_earliness", max_earliness});
-    seqfeats.insert({"max_stop_lateness", max_lateness});
-    seqfeats.insert({"max_stop_totness", max_earliness+max_lateness});
-    seqfeats.insert({"miss_early", miss_early});
-    seqfeats.insert({"miss_late", miss_late});
-    seqfeats.insert({"out_arrivals", miss_early+miss_late});
-    if (rtfeats.at("n_tws")!=0) {
-        seqfeats.insert({"p_out_arrivals", (miss_early+miss_late)
-                /rtfeats.at("n_tws")});
-    }
-    seqfeats.insert({"sim_macro", sim_macro});
-    seqfeats.insert({"sim_micro", sim_micro});
-    seqfeats.insert({"sim_nano", sim_nano});
-    seqfeats.insert({"trans_by_distinct_macro",
-            trans_macro/rtfeats.at("distinct_macro")});
-    seqfeats.insert({"trans_by_distinct_micro",
-            trans_micro/rtfeats.at("distinct_micro")});
-    seqfeats.insert({"trans_by_distinct_nano",
-            trans_nano/rtfeats.at("distinct_nano")});
-    seqfeats.insert({"sim_by_trans_macro", (1.0*sim_macro)/trans_macro});
-    seqfeats.insert({"sim_by_trans_micro", (1.0*sim_micro)/trans_micro});
-    seqfeats.insert({"sim_by_trans_nano", (1.0*sim_nano)/trans_nano});
-    seqfeats.insert({"d_sim_by_trans_macro", seqfeats.at("sim_by_trans_macro")
-            -stats.at("min_sim_by_trans_macro")});
-    seqfeats.insert({"d_sim_by_trans_micro", seqfeats.at("sim_by_trans_micro")
-            -stats.at("min_sim_by_trans_micro")});
-    seqfeats.insert({"d_sim_by_trans_nano", seqfeats.at("sim_by_trans_nano")
-            -stats.at("min_sim_by_trans_nano")});
-    if (stats.at("max_sim_by_trans_macro")!=0) {
-        seqfeats.insert({"r_sim_by_trans_macro", ((1.0*sim_macro)/trans_macro)/
-                stats.at("max_sim_by_trans_macro")});
-    }
-    if (stats.at("max_sim_by_trans_micro")!=0) {
-        seqfeats.insert({"r_sim_by_trans_micro", ((1.0*sim_micro)/trans_micro)/
-                stats.at("max_sim_by_trans_micro")});
-    }
-    if (stats.at("max_sim_by_trans_nano")!=0) {
-        seqfeats.insert({"r_sim_by_trans_nano", ((1.0*sim_nano)/trans_nano)/
-                stats.at("max_sim_by_trans_nano")});
-    }
-    unordered_map<string, double> expansion;
-    // basis expansion between station and sequence features
-    for (const auto& seqfeat : seqfeats)
-        expansion.insert({r.station()+"_*_"+seqfeat.first, seqfeat.second});
-    // basis expansion between sequence features and route features
-    for (const auto& seqfeat : seqfeats)
-        for (const auto& rtfeat : rtfeats) {
-            expansion.insert({seqfeat.first+"_*_"+rtfeat.first,
-                    seqfeat.second*rtfeat.second});
-        }
-    seqfeats.insert(expansion.begin(), expansion.end());
-    // intercept term
-    seqfeats.insert({"intercept", 1});
-    // protection against nan's or inf's
-    for (auto& kv : seqfeats)
-        if (!isfinite(kv.second)) {
-            cout<<"warning: feature \""<<kv.first<<"\" is '"<<kv.second
-                    <<"'  ;  setting to zero"<<endl;
-            kv.second=0;
-        }
-    return seqfeats;
+void Sequence::features(const double* rt,
+        const unordered_map<string, double>& stats, double* x) const {
+    typedef FeatureRegistry FR;
+    FR::sequenceFeatures(*this, stats, rt, x);
+    FR::expand(x, rt, x);
 }
 
-unordered_map<string,double> Sequence::statistics(const vector<Sequence>& seqs){
-    unordered_map<string, double> stats;
-    double min_duration=numeric_limits<double>::max();
-    double min_sim_by_trans_macro=numeric_limits<double>::max();
-    double min_sim_by_trans_micro=numeric_limits<double>::max();
-    double min_sim_by_trans_nano=numeric_limits<double>::max();
-    double max_sim_by_trans_macro=0;
-    double max_sim_by_trans_micro=0;
-    double max_sim_by_trans_nano=0;
-    size_t with_totness=0;
-    size_t with_out_arrivals=0;
-    double tot_earliness=0;
-    double tot_lateness=0;
-    for (const auto& seq : seqs) {
-        if (seq.dur < min_duration)
-            min_duration=seq.dur;
-        const double sbtmacro=(1.0*seq.sim_macro)/seq.trans_macro;
-        const double sbtmicro=(1.0*seq.sim_micro)/seq.trans_micro;
-        const double sbtnano=(1.0*seq.sim_nano)/seq.trans_nano;
-        if (sbtmacro < min_sim_by_trans_macro)
-            min_sim_by_trans_macro=sbtmacro;
-        if (sbtmicro < min_sim_by_trans_micro)
-            min_sim_by_trans_micro=sbtmicro;
-        if (sbtnano < min_sim_by_trans_nano)
-            min_sim_by_trans_nano=sbtnano;
-        if (sbtmacro > max_sim_by_trans_macro)
-            max_sim_by_trans_macro=sbtmacro;
-        if (sbtmicro > max_sim_by_trans_micro)
-            max_sim_by_trans_micro=sbtmicro;
-        if (sbtnano > max_sim_by_trans_nano)
-            max_sim_by_trans_nano=sbtnano;
-        if (seq.earliness()+seq.lateness()>=50)
-            with_totness++;
-        if (seq.miss_early+seq.miss_late>0)
-            with_out_arrivals++;
-        tot_earliness+=seq.earliness();
-        tot_lateness+=seq.lateness();
-    }
-    stats.insert({"min_duration", min_duration});
-    stats.insert({"min_sim_by_trans_macro", min_sim_by_trans_macro});
-    stats.insert({"min_sim_by_trans_micro", min_sim_by_trans_micro});
-    stats.insert({"min_sim_by_trans_nano", min_sim_by_trans_nano});
-    stats.insert({"max_sim_by_trans_macro", max_sim_by_trans_macro});
-    stats.insert({"max_sim_by_trans_micro", max_sim_by_trans_micro});
-    stats.insert({"max_sim_by_trans_nano", max_sim_by_trans_nano});
-    double p_with_totness=(1.0*with_totness)/seqs.size();
-    stats.insert({"p_with_totness", p_with_totness});
-    stats.insert({"p_wout_totness", 1-p_with_totness});
-    double p_with_out_arrivals=(1.0*with_out_arrivals)/seqs.size();
-    stats.insert({"p_with_out_arrivals", p_with_out_arrivals});
-    stats.insert({"p_wout_out_arrivals", 1-p_with_out_arrivals});
-    stats.insert({"avg_earliness", tot_earliness/seqs.size()});
-    stats.insert({"avg_lateness", tot_lateness/seqs.size()});
-    return stats;
+unordered_map<string, double> Sequence::features(const Route& r,
+        const unordered_map<string, double>& stats) const {
+    typedef FeatureRegistry FR;
+    vector<double> rt(FR::RT_N), x(FR::numFeatures());
+    FR::routeFeatures(r, stats, rt.data());
+    features(rt.data(), stats, x.data());
+    const auto names=FR::featureNames(r.station());
+    unordered_map<string, double> feats;
+    for (size_t k=0; k<x.size(); ++k)
+        if (!isnan(x[k]))
+            feats.insert({names[k], x[k]});
+    return feats;
 }
 
 int Sequence::macroTransitions(const Sequence& seq, const Route& r) {
@@ -298,9 +288,29 @@ int Sequence::nanoTransitions(const Sequence& seq, const Route& r) {
 
 double Sequence::score(const Route& r, const Sequence& prop,
         const Sequence& actual) {
+    return score(r.travelTimes().normalize(), prop, actual);
+}
+
+pair<double, bool> Sequence::score(const TTMatrix& normtts,
+        const Sequence& prop, const Sequence& actual, double cutoff) {
+    const double dev=actual.deviation(prop);
+    if (dev<=0)
+        return {0, false};
+    vector<size_t> act, prp;    // no station
+    for (size_t i=1; i<actual.stops_.size(); ++i)
+        act.push_back(normtts.index(actual.stops_[i]));
+    for (size_t i=1; i<prop.stops_.size(); ++i)
+        prp.push_back(normtts.index(prop.stops_[i]));
+    bool bounded=false;
+    const double erp=erpPerEdit(act, prp, normtts, 1000, cutoff/dev, bounded);
+    return {dev*erp, bounded};
+}
+
+double Sequence::score(const TTMatrix& normtts, const Sequence& prop,
+        const Sequence& actual) {
     deque<string> act(actual.stops_.begin()+1, actual.stops_.end());//no station
     deque<string> prp(prop.stops_.begin()+1, prop.stops_.end());
-    auto normtts=r.travelTimes().normalize();
     return actual.deviation(prop)*Sequence::erpPerEdit(act, prp, normtts, 1000);
 }
 
+
@@ -26,18 +26,7 @@ class Sequence {
         int trans_macro=-1, trans_micro=-1, trans_nano=-1;
         std::vector<std::string> stops_;
         std::unordered_map<std::string, size_t> stopid_to_idx;
-        static double distErp(const std::string& s1, const std::string& s2,
-                const TTMatrix& ttimes, const double g) {
-            return s1=="gap"||s2=="gap" ? g : ttimes.travelTime(s1, s2);
-        }
         typedef std::deque<std::string> Seq;
-        typedef std::pair<size_t, size_t> sizet_pair;
-        static std::pair<double, size_t> erpPerEditHelper(const Seq& actual,
-                size_t h_actual, const Seq& sub, size_t h_sub,
-                const TTMatrix& ttimes, const double g,
-                std::unordered_map<sizet_pair, std::pair<double, size_t>,
-                boost::hash<sizet_pair>>& memo);
-        static double gapSum(const Seq& s, double g) {return s.size()*g;}
     public:
         Sequence(std::vector<std::string> stps);
         void addStop(std::string stopid) {
@@ -51,13 +40,21 @@ class Sequence {
         int earlyArrivals() const {return miss_early;}
         double earliness(int s) const {return st_earliness[s];}
         static double erpPerEdit(const Seq& actual, const Seq& sub,
-                const TTMatrix& ttimes, const double g) {
-            std::unordered_map<sizet_pair, std::pair<double, size_t>,
-                    boost::hash<sizet_pair>> memo;
-            auto res=erpPerEditHelper(actual, 0, sub, 0, ttimes, g, memo);
-            return res.second==0 ? 0 : res.first/res.second;
-        }
+                const TTMatrix& ttimes, const double g);
+        // actual/sub: stop indices of ttimes
+        static double erpPerEdit(const std::vector<size_t>& actual,
+                const std::vector<size_t>& sub, const TTMatrix& ttimes,
+                const double g);
+        // stops early if the result can't be below cutoff: then 'bounded' is
+        // set and a lower bound (>=cutoff) is returned
+        static double erpPerEdit(const std::vector<size_t>& actual,
+                const std::vector<size_t>& sub, const TTMatrix& ttimes,
+                const double g, const double cutoff, bool& bounded);
         void exportJSON(std::ofstream& os) const;
+        // dense features, see FeatureRegistry (rt: route features)
+        void features(const double* rt,
+                const std::unordered_map<std::string, double>& stats,
+                double* x) const;
         std::unordered_map<std::string, double> features(const Route& r,
                 const std::unordered_map<std::string, double>& stats) const;
         int lateArrivals() const {return miss_late;}
@@ -76,6 +73,13 @@ class Sequence {
         int nanoTransitions() const {return trans_nano;}
         static double score(const Route& r, const Sequence& prop,
                 const Sequence& actual);
+        // normtts: normalized travel times of the route
+        static double score(const TTMatrix& normtts, const Sequence& prop,
+                const Sequence& actual);
+        // {score, false} if the score is below cutoff, otherwise possibly only
+        // {lower bound, true} (the bound is >= cutoff)
+        static std::pair<double, bool> score(const TTMatrix& normtts,
+                const Sequence& prop, const Sequence& actual, double cutoff);
         void setDuration(double d) {dur=d;}
         void setEarliness(double e) {earliness_=e;}
         void setEarlyArrivals(int a) {miss_early=a;}
@@ -95,8 +99,6 @@ class Sequence {
             trans_micro=micro;
             trans_nano=nano;
         }
-        static std::unordered_map<std::string, double> statistics(
-                const std::vector<Sequence>& seqs);
         const std::vector<std::string>& stops() const {return stops_;}
         std::vector<std::string>& stops() {return stops_;}
         void swap(size_t i, size_t j) {
@@ -1,44 +1,107 @@
 #include <algorithm>
+#include <limits>
+#include "Random.h"
+#include "RoutingPattern.h"
 #include "SequenceBuilder.h"
 #include "TSPHeuristic.h"
 
 using namespace std;
 
-void SequenceBuilder::adjustIndicesAndCosts(
-        unordered_map<string, size_t>& stop_to_idx,
-        vector<string>& idx_to_stop, vector<vector<double>>& costs,
-        const string& entry, const string& exit) {
-    if (entry==exit)
-        cout<<"warning: entry and exit are the same"<<endl;
-    // entry must become index 1
-    if (stop_to_idx.at(entry)!=1) {
-        const auto curr_entry_idx=stop_to_idx.at(entry);
-        const auto curr_stop_at_1=idx_to_stop[1];
-        // update stop_to_idx
-        stop_to_idx.at(entry)=1;
-        stop_to_idx.at(curr_stop_at_1)=curr_entry_idx;
-        // update idx_to_stop
-        idx_to_stop[1]=entry;
-        idx_to_stop[curr_entry_idx]=curr_stop_at_1;
-        // update cost matrix
-        swap(costs[curr_entry_idx], costs[1]);          // swap rows
-        for (size_t i=0; i<costs.size(); ++i)           // swap columns
-            swap(costs[i][curr_entry_idx], costs[i][1]);
+// orders nodes as a path starting after 'anchor' (random insertion over the
+// nodes plus the anchor, with free arcs back to the anchor); cost(i,j) is
+// given by a functor; tsp and buf are reused across calls
+template<class Cost> static void orderPath(size_t anchor,
+        vector<size_t>& nodes, Cost cost, TSPHeuristic& tsp,
+        vector<size_t>& buf, Random::Stream& g) {
+    const size_t m=nodes.size();
+    if (m<2)
+        return;
+    tsp.setCosts(m+1, [&](size_t i, size_t j) -> double {
+        if (j==0 || i==j)
+            return 0;
+        return cost(i==0 ? anchor : nodes[i-1], nodes[j-1]);
+    });
+    tsp.setStream(Random::Stream(g()));
+    const auto sol=tsp.randomInsertion(0, false);
+    const auto& tour=sol.tour();
+    const size_t k=find(tour.begin(), tour.end(), 0)-tour.begin();
+    buf.clear();
+    for (size_t p=1; p<=m; ++p)
+        buf.push_back(nodes[tour[(k+p)%(m+1)]-1]);
+    nodes.swap(buf);
+}
+
+// zones of one level (z x z row-major costs)
+static void orderPath(size_t anchor, vector<size_t>& zones,
+        const vector<double>& zcosts, size_t z, TSPHeuristic& tsp,
+        vector<size_t>& buf, Random::Stream& g) {
+    orderPath(anchor, zones, [&zcosts, z](size_t a, size_t b)
+            {return zcosts[a*z+b];}, tsp, buf, g);
+}
+
+// stops (travel times)
+static void orderPath(size_t anchor, vector<size_t>& stops,
+        const DenseRoute& dr, TSPHeuristic& tsp, vector<size_t>& buf,
+        Random::Stream& g) {
+    orderPath(anchor, stops, [&dr](size_t a, size_t b)
+            {return dr.travelTime(a, b);}, tsp, buf, g);
+}
+
+void SequenceBuilder::addRandom(SequencePool& seqpool, const Route& r,
+        const vector<pair<string, string>>& combis, size_t first,
+        double p_micro, double p_nano, TSPHeuristic::Insertion ins) {
+    // create indices to convert from stopids (strings) to numerical indexes
+    unordered_map<string, size_t> stop_to_idx;
+    vector<string> idx_to_stop(1);    // reserve index 0 to station
+    for (const auto& kv : r.stops()) {
+        if (r.getStop(kv.first).type()==Stop::Type::station) {
+            stop_to_idx[kv.first]=0;
+            idx_to_stop[0]=kv.first;
+        } else {
+            stop_to_idx[kv.first]=idx_to_stop.size();
+            idx_to_stop.push_back(kv.first);
+        }
     }
-    // exit must become index 2
-    if (stop_to_idx.at(exit)!=2) {
-        const auto curr_exit_idx=stop_to_idx.at(exit);
-        const auto curr_stop_at_2=idx_to_stop[2];
-        // update stop_to_idx
-        stop_to_idx.at(exit)=2;
-        stop_to_idx.at(curr_stop_at_2)=curr_exit_idx;
-        // update idx_to_stop
-        idx_to_stop[2]=exit;
-        idx_to_stop[curr_exit_idx]=curr_stop_at_2;
-        // update cost matrix
-        swap(costs[curr_exit_idx], costs[2]);           // swap rows
-        for (size_t i=0; i<costs.size(); ++i)           // swap columns
-            swap(costs[i][curr_exit_idx], costs[i][2]);
+    const auto costs=createCostMatrix(r, stop_to_idx, p_micro, p_nano);
+    seqpool.reserve(seqpool.size()+combis.size());
+    const auto& dr=seqpool.route();
+    vector<size_t> dense;
+    if (ins==TSPHeuristic::Insertion::timeWindows) {
+        dense.resize(idx_to_stop.size());
+        for (size_t i=0; i<dense.size(); ++i)
+            dense[i]=dr.index(idx_to_stop[i]);
+    }
+    for (const auto& p : combis)
+        if (p.first==p.second)
+            cout<<"warning: entry and exit are the same"<<endl;
+    // combinations are solved in parallel into their own slot; tour i only
+    // depends on stream first+i+1 (index 0 is used by buildRandom(r, n, ...)),
+    // so the pool is the same for any number of threads or chunks
+    vector<vector<size_t>> tours(combis.size());
+    #pragma omp parallel
+    {
+        // one solver per thread: entry/exit only change the guide tour
+        TSPHeuristic tsp(costs, Random::stream(r.id(),
+                Random::Purpose::randomTours, 1));
+        if (ins==TSPHeuristic::Insertion::timeWindows)
+            // earliness/lateness seconds weigh as much as travel seconds
+            tsp.setTimeWindows(dr, dense, 1);
+        vector<size_t> guide(3, 0);     // station, entry and exit
+        #pragma omp for schedule(dynamic, 16)
+        for (size_t i=0; i<combis.size(); ++i) {
+            tsp.setStream(Random::stream(r.id(),
+                    Random::Purpose::randomTours, first+i+1));
+            guide[1]=stop_to_idx.at(combis[i].first);
+            guide[2]=stop_to_idx.at(combis[i].second);
+            tours[i]=toTour(dr, idx_to_stop,
+                    tsp.insertion(ins, guide, true).tour());
+        }
+    }
+    for (size_t i=0; i<combis.size(); ++i) {
+        if (dr.id(tours[i][1])!=combis[i].first
+                || dr.id(tours[i].back())!=combis[i].second)
+            cout<<"warning: invalid entry or exit stop"<<endl;
+        seqpool.add(tours[i]);      // duplicated tours are dropped
     }
 }
 
@@ -86,7 +149,8 @@ vector<Sequence> SequenceBuilder::buildGuided(const Route& r, size_t n,
             costs[j][i]=costs[i][j];
         }
     // pool diverse set of sequences that are similar to the guide tour
-    TSPHeuristic tsp(move(costs));
+    TSPHeuristic tsp(costs,
+            Random::stream(r.id(), Random::Purpose::guidedTours));
     auto tsppool=tsp.pool(n, guide.size(), true);
     // convert all solutions to Sequence's and save
     vector<Sequence> seqpool;
@@ -103,6 +167,138 @@ vector<Sequence> SequenceBuilder::buildGuided(const Route& r, size_t n,
     return seqpool;
 }
 
+SequencePool SequenceBuilder::buildHierarchical(const Route& r, size_t n,
+        const RoutingPattern& patt) {
+    SequencePool seqpool(r);
+    const auto& dr=seqpool.route();
+    typedef DenseRoute::Level Level;
+    const Level levels[3]={Level::macro, Level::micro, Level::nano};
+    // zone tree: children of each macro/micro zone, stops of each nano zone;
+    // stops with unknown zone are inserted at the end
+    vector<vector<size_t>> children[3];
+    vector<size_t> unknown;
+    for (size_t l=0; l<3; ++l)
+        children[l].resize(dr.zones(levels[l]));
+    for (size_t i=0; i<dr.size(); ++i) {
+        if (i==dr.station())
+            continue;
+        if (dr.unknownZone(i)) {
+            unknown.push_back(i);
+            continue;
+        }
+        const size_t z[3]={size_t(dr.zone(Level::macro, i)),
+                size_t(dr.zone(Level::micro, i)),
+                size_t(dr.zone(Level::nano, i))};
+        for (size_t l=0; l<2; ++l)
+            if (find(children[l][z[l]].begin(), children[l][z[l]].end(),
+                    z[l+1])==children[l][z[l]].end())
+                children[l][z[l]].push_back(z[l+1]);
+        children[2][z[2]].push_back(i);
+    }
+    vector<size_t> tops;        // macro zones
+    for (size_t z=0; z<children[0].size(); ++z)
+        if (!children[0][z].empty())
+            tops.push_back(z);
+    vector<double> zcosts[3];
+    for (size_t l=0; l<3; ++l)
+        zcosts[l]=zoneCosts(dr, patt, levels[l]);
+    const size_t zstation[3]={size_t(dr.zone(Level::macro, dr.station())),
+            size_t(dr.zone(Level::micro, dr.station())),
+            size_t(dr.zone(Level::nano, dr.station()))};
+    // unknown-zone stops are only inserted next to their nearest stops (or
+    // the station), found once
+    const size_t k=8;
+    vector<vector<size_t>> nearest(unknown.size());
+    vector<size_t> others;
+    for (size_t u=0; u<unknown.size(); ++u) {
+        const size_t i=unknown[u];
+        others.clear();
+        for (size_t j=0; j<dr.size(); ++j)
+            if (j!=i && j!=dr.station())
+                others.push_back(j);
+        const auto closer=[&dr, i](size_t a, size_t b) {
+            return min(dr.travelTime(i, a), dr.travelTime(a, i))
+                    < min(dr.travelTime(i, b), dr.travelTime(b, i));
+        };
+        const size_t m=min(k, others.size());
+        partial_sort(others.begin(), others.begin()+m, others.end(), closer);
+        nearest[u].assign(others.begin(), others.begin()+m);
+        nearest[u].push_back(dr.station());
+    }
+    // one solver and one set of buffers for all zones and samples
+    TSPHeuristic tsp(Random::Stream(0));
+    vector<size_t> macros, micros, nanos, stops, buf;
+    vector<size_t> succ(dr.size()), pred(dr.size());
+    vector<char> intour(dr.size());
+    seqpool.reserve(n);
+    vector<size_t> tour;
+    tour.reserve(dr.size());
+    for (size_t s=0; s<n; ++s) {
+        auto g=Random::stream(r.id(), Random::Purpose::hierarchicalTours, s);
+        tour.assign(1, dr.station());
+        size_t last[3]={zstation[0], zstation[1], zstation[2]};
+        macros=tops;
+        orderPath(last[0], macros, zcosts[0], dr.zones(Level::macro), tsp,
+                buf, g);
+        for (const auto zmacro : macros) {
+            micros=children[0][zmacro];
+            orderPath(last[1], micros, zcosts[1], dr.zones(Level::micro), tsp,
+                    buf, g);
+            for (const auto zmicro : micros) {
+                nanos=children[1][zmicro];
+                orderPath(last[2], nanos, zcosts[2], dr.zones(Level::nano),
+                        tsp, buf, g);
+                for (const auto znano : nanos) {
+                    stops=children[2][znano];
+                    orderPath(tour.back(), stops, dr, tsp, buf, g);
+                    tour.insert(tour.end(), stops.begin(), stops.end());
+                    last[2]=znano;
+                }
+                last[1]=zmicro;
+            }
+            last[0]=zmacro;
+        }
+        if (!unknown.empty()) {
+            // cheapest insertion of the stops with unknown zone into the arcs
+            // entering/leaving their nearest stops (linked tour)
+            fill(intour.begin(), intour.end(), 0);
+            for (size_t p=0; p<tour.size(); ++p) {
+                succ[tour[p]]=tour[(p+1)%tour.size()];
+                pred[succ[tour[p]]]=tour[p];
+                intour[tour[p]]=1;
+            }
+            for (size_t u=0; u<unknown.size(); ++u) {
+                const size_t i=unknown[u];
+                size_t besta=dr.station();
+                double bestcost=numeric_limits<double>::max();
+                for (const auto v : nearest[u]) {
+                    if (!intour[v])
+                        continue;
+                    for (const auto a : {pred[v], v}) {
+                        const double cost=dr.travelTime(a, i)
+                                +dr.travelTime(i, succ[a])
+                                -dr.travelTime(a, succ[a]);
+                        if (cost<bestcost) {
+                            besta=a;
+                            bestcost=cost;
+                        }
+                    }
+                }
+                succ[i]=succ[besta];
+                pred[succ[i]]=i;
+                succ[besta]=i;
+                pred[i]=besta;
+                intour[i]=1;
+            }
+            tour.assign(1, dr.station());
+            for (size_t v=succ[dr.station()]; v!=dr.station(); v=succ[v])
+                tour.push_back(v);
+        }
+        seqpool.add(tour);      // duplicated tours are dropped
+    }
+    return seqpool;
+}
+
 vector<Sequence> SequenceBuilder::buildOrdered(const Route& r, size_t n,
         const vector<string>& order, double p_micro, double p_nano) {
     unordered_map<string, size_t> stop_to_idx;
@@ -120,7 +316,8 @@ vector<Sequence> SequenceBuilder::buildOrdered(const Route& r, size_t n,
             idx_to_stop.push_back(kv.first);
         }
     }
-    TSPHeuristic tsp(createCostMatrix(r, stop_to_idx, p_micro, p_nano));
+    TSPHeuristic tsp(createCostMatrix(r, stop_to_idx, p_micro, p_nano),
+            Random::stream(r.id(), Random::Purpose::orderedTours));
     auto tsppool=tsp.pool(n, order.size()+1, false);
     vector<Sequence> seqpool;
     seqpool.reserve(tsppool.size());
@@ -132,39 +329,15 @@ vector<Sequence> SequenceBuilder::buildOrdered(const Route& r, size_t n,
     return seqpool;
 }
 
-vector<Sequence> SequenceBuilder::buildRandom(const Route& r,
+SequencePool SequenceBuilder::buildRandom(const Route& r,
         const vector<pair<string, string>>& combis, double p_micro,
-        double p_nano) {
-    // create indices to convert from stopids (strings) to numerical indexes
-    unordered_map<string, size_t> stop_to_idx;
-    vector<string> idx_to_stop(1);    // reserve index 0 to station
-    for (const auto& kv : r.stops()) {
-        if (r.getStop(kv.first).type()==Stop::Type::station) {
-            stop_to_idx[kv.first]=0;
-            idx_to_stop[0]=kv.first;
-        } else {
-            stop_to_idx[kv.first]=idx_to_stop.size();
-            idx_to_stop.push_back(kv.first);
-        }
-    }
-    auto costs=createCostMatrix(r, stop_to_idx, p_micro, p_nano);
-    vector<Sequence> seqpool;
-    for (const auto& p : combis) {
-        if (p.first==p.second)
-            cout<<"warning: entry and exit are the same"<<endl;
-        // adjust indices and costs such that entry/exit become indices 1/2
-        adjustIndicesAndCosts(stop_to_idx,idx_to_stop,costs,p.first,p.second);
-        if (stop_to_idx.at(p.first)!=1 || stop_to_idx.at(p.second)!=2)
-            cout<<"warning: incorrect entry or exit index"<<endl;
-        // 3=station, entry and exit
-        seqpool.push_back(toSequence(r, idx_to_stop,
-                TSPHeuristic(costs).randomInsertion(3, true).tour()));
-        r.setupTiming(seqpool.back());
-    }
+        double p_nano, TSPHeuristic::Insertion ins) {
+    SequencePool seqpool(r);
+    addRandom(seqpool, r, combis, 0, p_micro, p_nano, ins);
     return seqpool;
 }
 
-vector<Sequence> SequenceBuilder::buildRandom(const Route& r, size_t n,
+SequencePool SequenceBuilder::buildRandom(const Route& r, size_t n,
         double p_micro, double p_nano) {
     // create indices to convert from stopids (strings) to numerical indexes
     unordered_map<string, size_t> stop_to_idx;
@@ -175,19 +348,14 @@ vector<Sequence> SequenceBuilder::buildRandom(const Route& r, size_t n,
         idx_to_stop.push_back(kv.first);
     }
     // pool diverse set of (non-optimal) TSP solutions
-    TSPHeuristic tsp(createCostMatrix(r, stop_to_idx, p_micro, p_nano));
+    TSPHeuristic tsp(createCostMatrix(r, stop_to_idx, p_micro, p_nano),
+            Random::stream(r.id(), Random::Purpose::randomTours));
     auto tsppool=tsp.pool(n, 0, false);
-    // convert all solutions to Sequence's and save
-    vector<Sequence> seqpool;
+    // convert all solutions to station-first tours and save
+    SequencePool seqpool(r);
     seqpool.reserve(tsppool.size());
     for (const auto& sol : tsppool) {
-        auto seq=toSequence(r, idx_to_stop, sol.tour());
-        r.setupTiming(seq);
-        /* equality does not hold anymore when applying transition penalties
-        if (abs(sol.value()-seq.duration())>1e-8)
-            cout<<"warning: sequence duration inconsistent"<<endl;
-        */
-        seqpool.push_back(move(seq));
+        seqpool.add(toTour(seqpool.route(), idx_to_stop, sol.tour()));
     }
     return seqpool;
 }
@@ -229,3 +397,47 @@ Sequence SequenceBuilder::toSequence(const Route& r,
     return seq;
 }
 
+
+vector<size_t> SequenceBuilder::toTour(const DenseRoute& dr,
+        const vector<string>& idx_to_stop, const vector<size_t>& tour) {
+    size_t k=0;     // advance until tour starts at the depot
+    while (dr.index(idx_to_stop[tour[k]])!=dr.station())
+        k++;
+    vector<size_t> dtour;
+    dtour.reserve(tour.size());
+    for (size_t i=k; i<tour.size(); ++i)
+        dtour.push_back(dr.index(idx_to_stop[tour[i]]));
+    for (size_t i=0; i<k; ++i)
+        dtour.push_back(dr.index(idx_to_stop[tour[i]]));
+    return dtour;
+}
+
+// mean travel time between the stops of two zones, divided by one plus the
+// number of times the transition was seen (patt)
+vector<double> SequenceBuilder::zoneCosts(const DenseRoute& dr,
+        const RoutingPattern& patt, DenseRoute::Level l) {
+    const size_t z=dr.zones(l);
+    vector<double> sum(z*z, 0), costs(z*z, 0);
+    vector<size_t> cnt(z*z, 0);
+    for (size_t i=0; i<dr.size(); ++i)
+        for (size_t j=0; j<dr.size(); ++j)
+            if (i!=j && !dr.unknownZone(i) && !dr.unknownZone(j)) {
+                const size_t k=dr.zone(l, i)*z+dr.zone(l, j);
+                sum[k]+=dr.travelTime(i, j);
+                cnt[k]++;
+            }
+    for (size_t a=0; a<z; ++a)
+        for (size_t b=0; b<z; ++b) {
+            if (a==b || cnt[a*z+b]==0)
+                continue;
+            const auto& za=dr.zoneName(l, a);
+            const auto& zb=dr.zoneName(l, b);
+            const auto& st=dr.stationCode();
+            const size_t seen=l==DenseRoute::Level::macro
+                    ? patt.countMacro(st, za, zb)
+                    : l==DenseRoute::Level::micro ? patt.countMicro(st, za, zb)
+                    : patt.countNano(st, za, zb);
+            costs[a*z+b]=sum[a*z+b]/cnt[a*z+b]/(1+seen);
+        }
+    return costs;
+}
@@ -6,31 +6,52 @@
 #include "BasicStop.h"
 #include "Route.h"
 #include "Sequence.h"
+#include "SequencePool.h"
+#include "TSPHeuristic.h"
 
+class RoutingPattern;
 class SequenceBuilder {
     private:
-        static void adjustIndicesAndCosts(
-                std::unordered_map<std::string, size_t>& stop_to_idx,
-                std::vector<std::string>& idx_to_stop,
-                std::vector<std::vector<double>>& costs,
-                const std::string& entry, const std::string& exit);
         static std::vector<std::vector<double>> createCostMatrix(const Route& r,
                 const std::unordered_map<std::string, size_t>& stop_to_idx,
                 double p_micro, double p_nano);
         static Sequence toSequence(const Route& r,
                 const std::vector<std::string>& idx_to_stop,
                 const std::vector<size_t>& tour);
+        static std::vector<size_t> toTour(const DenseRoute& dr,
+                const std::vector<std::string>& idx_to_stop,
+                const std::vector<size_t>& tour);
+        static std::vector<double> zoneCosts(const DenseRoute& dr,
+                const RoutingPattern& patt, DenseRoute::Level l);
     public:
+        // adds one tour per entry/exit pair to the pool; combis[0] is pair
+        // number 'first' of the whole sample (the random stream of a pair
+        // only depends on its number, see buildRandom)
+        static void addRandom(SequencePool& pool, const Route& r,
+                const std::vector<std::pair<std::string, std::string>>& combis,
+                size_t first, double p_micro, double p_nano,
+                TSPHeuristic::Insertion ins=TSPHeuristic::Insertion::random);
         static std::vector<Sequence> buildGuided(const Route& r, size_t n,
                 const std::vector<BasicStop>& guide);
+        // macro zones are ordered first, then the micro zones of each macro
+        // zone, the nano zones of each micro zone and the stops of each nano
+        // zone, each as a small TSP path starting after the previous one
+        // (zone costs: see zoneCosts); near-linear in the route size as long
+        // as zones stay small; pooled tours are not evaluated yet
+        static SequencePool buildHierarchical(const Route& r, size_t n,
+                const RoutingPattern& patt);
         static std::vector<Sequence> buildOrdered(const Route& r, size_t n,
                 const std::vector<std::string>& order, double p_micro,
                 double p_nano);
-        static std::vector<Sequence> buildRandom(const Route& r, size_t n,
+        // pooled tours are not evaluated yet (see SequencePool::evaluate)
+        static SequencePool buildRandom(const Route& r, size_t n,
                 double p_micro, double p_nano);
-        static std::vector<Sequence> buildRandom(const Route& r,
+        // one tour per entry/exit pair (cheapest/farthest: deterministic,
+        // timeWindows: random order, also scoring earliness and lateness)
+        static SequencePool buildRandom(const Route& r,
                 const std::vector<std::pair<std::string, std::string>>& combis,
-                double p_micro, double p_nano);
+                double p_micro, double p_nano, TSPHeuristic::Insertion ins=
+                TSPHeuristic::Insertion::random);
 };
 
 #endif
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include "RoutingPattern.h"
+#include "SequenceEvaluator.h"
+
+using namespace std;
+
+SequenceEvaluator::SequenceEvaluator(const DenseRoute& r,
+        const RoutingPattern& patt) : dr(r) {
+    typedef DenseRoute::Level Level;
+    const Level levels[3]={Level::macro, Level::micro, Level::nano};
+    const auto& st=dr.stationCode();
+    for (size_t l=0; l<3; ++l) {
+        const size_t z=dr.zones(levels[l]);
+        counts[l].assign(z*z, 0);
+        seen[l].assign(z*z, 0);
+        for (size_t a=0; a<z; ++a)
+            for (size_t b=0; b<z; ++b) {
+                const auto& za=dr.zoneName(levels[l], a);
+                const auto& zb=dr.zoneName(levels[l], b);
+                counts[l][a*z+b]=l==0 ? patt.countMacro(st, za, zb)
+                        : l==1 ? patt.countMicro(st, za, zb)
+                        : patt.countNano(st, za, zb);
+            }
+    }
+}
+
+void SequenceEvaluator::evaluate(const size_t* tour, Metrics& m) {
+    typedef DenseRoute::Level Level;
+    if (++epoch==0) {       // wrapped around: forget all pairs
+        for (size_t l=0; l<3; ++l)
+            fill(seen[l].begin(), seen[l].end(), 0);
+        epoch=1;
+    }
+    const size_t n=dr.size();
+    m=Metrics();
+    auto& t=m.timing;
+    long tp_e=0, tp_l=0;
+    int last_macro=0, last_micro=0, last_nano=0;
+    // similarity ignores dropoffs with unknown zone; pairs are cyclic
+    const size_t npos=static_cast<size_t>(-1);
+    size_t first=npos, prev=npos;
+    for (size_t i=0; i<n; ++i) {
+        const size_t s=tour[i];
+        if (i>0) {
+            const size_t from=tour[i-1];
+            t.duration+=dr.travelTime(from, s);
+            tp_e+=dr.earlyTravelTime(from, s);
+            tp_l+=dr.lateTravelTime(from, s);
+            if (dr.hasTW(s)) {
+                if (tp_e<dr.startTW(s)) {
+                    const double e=dr.startTW(s)-tp_e;
+                    t.earliness+=e;
+                    t.miss_early++;
+                    t.max_earliness=max(t.max_earliness, e);
+                }
+                if (tp_l>dr.endTW(s)) {
+                    const double l=tp_l-dr.endTW(s);
+                    t.lateness+=l;
+                    t.miss_late++;
+                    t.max_lateness=max(t.max_lateness, l);
+                }
+            }
+            tp_e+=dr.earlyServiceTime(s);
+            tp_l+=dr.lateServiceTime(s);
+        }
+        const int zmacro=dr.zone(Level::macro, s);
+        const int zmicro=dr.zone(Level::micro, s);
+        const int znano=dr.zone(Level::nano, s);
+        if (zmacro!=0 && zmacro!=last_macro) {
+            m.trans_macro++;
+            last_macro=zmacro;
+        }
+        if (zmicro!=0 && zmicro!=last_micro) {
+            m.trans_micro++;
+            last_micro=zmicro;
+        }
+        if (znano!=0 && znano!=last_nano) {
+            m.trans_nano++;
+            last_nano=znano;
+        }
+        if (!dr.unknownZone(s)) {
+            if (prev==npos)
+                first=s;
+            else {
+                m.sim_macro+=visitPair(Level::macro, prev, s);
+                m.sim_micro+=visitPair(Level::micro, prev, s);
+                m.sim_nano+=visitPair(Level::nano, prev, s);
+            }
+            prev=s;
+        }
+    }
+    t.duration+=dr.travelTime(tour[n-1], tour[0]);      // back to station
+    if (prev!=npos) {       // closing pair (last to first)
+        m.sim_macro+=visitPair(Level::macro, prev, first);
+        m.sim_micro+=visitPair(Level::micro, prev, first);
+        m.sim_nano+=visitPair(Level::nano, prev, first);
+    }
+    // transitions are counted from 1 (as in Sequence::macroTransitions etc)
+    m.trans_macro++;
+    m.trans_micro++;
+    m.trans_nano++;
+}
+
+int SequenceEvaluator::visitPair(DenseRoute::Level l, size_t a, size_t b) {
+    const size_t k=static_cast<size_t>(l), z=dr.zones(l);
+    const size_t p=dr.zone(l, a)*z+dr.zone(l, b);
+    if (seen[k][p]==epoch)
+        return 0;
+    seen[k][p]=epoch;
+    return counts[k][p];
+}
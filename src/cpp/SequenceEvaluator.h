@@ -0,0 +1,32 @@
+#ifndef sequenceevaluator_h
+#define sequenceevaluator_h
+
+#include <vector>
+#include "DenseRoute.h"
+#include "TimingEvaluator.h"
+
+class RoutingPattern;
+// computes timing, similarity and transitions of a tour in a single pass
+// (same results as Route::setupTiming and Route::setupSimilarity); pattern
+// counts are looked up once per route, and zone pairs already seen are marked
+// with the current epoch such that no set is cleared between tours
+class SequenceEvaluator {
+    public:
+        class Metrics {
+            public:
+                TimingEvaluator::Timing timing;
+                int sim_macro=0, sim_micro=0, sim_nano=0;
+                int trans_macro=0, trans_micro=0, trans_nano=0;
+        };
+    private:
+        const DenseRoute& dr;
+        std::vector<int> counts[3];         // pattern counts, zones x zones
+        std::vector<unsigned> seen[3];      // epoch at which a pair was seen
+        unsigned epoch=0;
+        int visitPair(DenseRoute::Level l, size_t a, size_t b);
+    public:
+        SequenceEvaluator(const DenseRoute& r, const RoutingPattern& patt);
+        void evaluate(const size_t* tour, Metrics& m);
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include <iostream>
+#include <limits>
+#include "SequenceEvaluator.h"
+#include "SequencePool.h"
+#include "TimingEvaluator.h"
+
+using namespace std;
+
+const size_t SequencePool::npos;
+
+size_t SequencePool::add(const vector<size_t>& tour) {
+    if (tour.size()!=dr.size() || tour[0]!=dr.station())
+        cout<<"warning: invalid sequence"<<endl;
+    attempts_++;
+    const uint64_t h=hash(tour.data(), tour.size());
+    const auto range=hashes.equal_range(h);
+    for (auto it=range.first; it!=range.second; ++it)
+        if (equal(tour.begin(), tour.end(), this->tour(it->second)))
+            return npos;
+    const size_t i=dur.size();
+    hashes.insert({h, i});
+    keys.push_back(h);
+    tours.insert(tours.end(), tour.begin(), tour.end());
+    dur.push_back(0);
+    earliness_.push_back(0);
+    lateness_.push_back(0);
+    max_earliness.push_back(0);
+    max_lateness.push_back(0);
+    miss_early.push_back(-1);
+    miss_late.push_back(-1);
+    sim_macro.push_back(-1);
+    sim_micro.push_back(-1);
+    sim_nano.push_back(-1);
+    trans_macro.push_back(-1);
+    trans_micro.push_back(-1);
+    trans_nano.push_back(-1);
+    order.push_back(i);
+    return i;
+}
+
+// polynomial rolling hash (mod 2^64) over the stop indices of a tour
+uint64_t SequencePool::hash(const size_t* tour, size_t n) {
+    uint64_t h=0;
+    for (size_t p=0; p<n; ++p)
+        h=h*1000003+tour[p]+1;
+    return h;
+}
+
+void SequencePool::reserve(size_t n) {
+    tours.reserve(n*dr.size());
+    dur.reserve(n);
+    earliness_.reserve(n);
+    lateness_.reserve(n);
+    max_earliness.reserve(n);
+    max_lateness.reserve(n);
+    miss_early.reserve(n);
+    miss_late.reserve(n);
+    sim_macro.reserve(n);
+    sim_micro.reserve(n);
+    sim_nano.reserve(n);
+    trans_macro.reserve(n);
+    trans_micro.reserve(n);
+    trans_nano.reserve(n);
+    order.reserve(n);
+    hashes.reserve(n);
+    keys.reserve(n);
+}
+
+bool SequencePool::retour(size_t i) {
+    const size_t n=dr.size();
+    auto range=hashes.equal_range(keys[i]);
+    for (auto it=range.first; it!=range.second; ++it)
+        if (it->second==i) {
+            hashes.erase(it);
+            break;
+        }
+    keys[i]=hash(tour(i), n);
+    range=hashes.equal_range(keys[i]);
+    for (auto it=range.first; it!=range.second; ++it)
+        if (equal(tour(i), tour(i)+n, tour(it->second))) {
+            order.erase(find(order.begin(), order.end(), i));
+            merged++;
+            return false;
+        }
+    hashes.insert({keys[i], i});
+    return true;
+}
+
+Sequence SequencePool::sequence(size_t i) const {
+    auto seq=summary(i);
+    const size_t* t=tour(i);
+    for (size_t p=0; p<dr.size(); ++p)
+        seq.addStop(dr.id(t[p]));
+    vector<double> st_e(dr.size()), st_l(dr.size());
+    stopTiming(i, st_e.data(), st_l.data());
+    seq.setStopEarliness(move(st_e));
+    seq.setStopLateness(move(st_l));
+    return seq;
+}
+
+void SequencePool::evaluate(size_t i, SequenceEvaluator& ev) {
+    SequenceEvaluator::Metrics m;
+    ev.evaluate(tour(i), m);
+    dur[i]=m.timing.duration;
+    earliness_[i]=m.timing.earliness;
+    lateness_[i]=m.timing.lateness;
+    max_earliness[i]=m.timing.max_earliness;
+    max_lateness[i]=m.timing.max_lateness;
+    miss_early[i]=m.timing.miss_early;
+    miss_late[i]=m.timing.miss_late;
+    sim_macro[i]=m.sim_macro;
+    sim_micro[i]=m.sim_micro;
+    sim_nano[i]=m.sim_nano;
+    trans_macro[i]=m.trans_macro;
+    trans_micro[i]=m.trans_micro;
+    trans_nano[i]=m.trans_nano;
+}
+
+void SequencePool::setupTiming(size_t i) {
+    const auto t=TimingEvaluator::timing(dr, tour(i), dr.size());
+    dur[i]=t.duration;
+    earliness_[i]=t.earliness;
+    lateness_[i]=t.lateness;
+    max_earliness[i]=t.max_earliness;
+    max_lateness[i]=t.max_lateness;
+    miss_early[i]=t.miss_early;
+    miss_late[i]=t.miss_late;
+}
+
+unordered_map<string, double> SequencePool::statistics() const {
+    unordered_map<string, double> stats;
+    double min_duration=numeric_limits<double>::max();
+    double min_sim_by_trans_macro=numeric_limits<double>::max();
+    double min_sim_by_trans_micro=numeric_limits<double>::max();
+    double min_sim_by_trans_nano=numeric_limits<double>::max();
+    double max_sim_by_trans_macro=0;
+    double max_sim_by_trans_micro=0;
+    double max_sim_by_trans_nano=0;
+    size_t with_totness=0;
+    size_t with_out_arrivals=0;
+    double tot_earliness=0;
+    double tot_lateness=0;
+    for (const auto i : order) {
+        if (dur[i] < min_duration)
+            min_duration=dur[i];
+        const double sbtmacro=(1.0*sim_macro[i])/trans_macro[i];
+        const double sbtmicro=(1.0*sim_micro[i])/trans_micro[i];
+        const double sbtnano=(1.0*sim_nano[i])/trans_nano[i];
+        if (sbtmacro < min_sim_by_trans_macro)
+            min_sim_by_trans_macro=sbtmacro;
+        if (sbtmicro < min_sim_by_trans_micro)
+            min_sim_by_trans_micro=sbtmicro;
+        if (sbtnano < min_sim_by_trans_nano)
+            min_sim_by_trans_nano=sbtnano;
+        if (sbtmacro > max_sim_by_trans_macro)
+            max_sim_by_trans_macro=sbtmacro;
+        if (sbtmicro > max_sim_by_trans_micro)
+            max_sim_by_trans_micro=sbtmicro;
+        if (sbtnano > max_sim_by_trans_nano)
+            max_sim_by_trans_nano=sbtnano;
+        if (earliness_[i]+lateness_[i]>=50)
+            with_totness++;
+        if (miss_early[i]+miss_late[i]>0)
+            with_out_arrivals++;
+        tot_earliness+=earliness_[i];
+        tot_lateness+=lateness_[i];
+    }
+    stats.insert({"min_duration", min_duration});
+    stats.insert({"min_sim_by_trans_macro", min_sim_by_trans_macro});
+    stats.insert({"min_sim_by_trans_micro", min_sim_by_trans_micro});
+    stats.insert({"min_sim_by_trans_nano", min_sim_by_trans_nano});
+    stats.insert({"max_sim_by_trans_macro", max_sim_by_trans_macro});
+    stats.insert({"max_sim_by_trans_micro", max_sim_by_trans_micro});
+    stats.insert({"max_sim_by_trans_nano", max_sim_by_trans_nano});
+    double p_with_totness=(1.0*with_totness)/order.size();
+    stats.insert({"p_with_totness", p_with_totness});
+    stats.insert({"p_wout_totness", 1-p_with_totness});
+    double p_with_out_arrivals=(1.0*with_out_arrivals)/order.size();
+    stats.insert({"p_with_out_arrivals", p_with_out_arrivals});
+    stats.insert({"p_wout_out_arrivals", 1-p_with_out_arrivals});
+    stats.insert({"avg_earliness", tot_earliness/order.size()});
+    stats.insert({"avg_lateness", tot_lateness/order.size()});
+    return stats;
+}
+
+void SequencePool::stopTiming(size_t i, double* earliness, double* lateness)
+        const {
+    TimingEvaluator::timing(dr, tour(i), dr.size(), earliness, lateness);
+}
+
+Sequence SequencePool::summary(size_t i) const {
+    Sequence seq({});
+    seq.setDuration(dur[i]);
+    seq.setEarliness(earliness_[i]);
+    seq.setLateness(lateness_[i]);
+    seq.setMaxEarliness(max_earliness[i]);
+    seq.setMaxLateness(max_lateness[i]);
+    seq.setEarlyArrivals(miss_early[i]);
+    seq.setLateArrivals(miss_late[i]);
+    seq.setSimilarity(sim_macro[i], sim_micro[i], sim_nano[i]);
+    seq.setTransitions(trans_macro[i], trans_micro[i], trans_nano[i]);
+    return seq;
+}
@@ -0,0 +1,78 @@
+#ifndef sequencepool_h
+#define sequencepool_h
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DenseRoute.h"
+#include "Sequence.h"
+
+class Route;
+class SequenceEvaluator;
+// pool of candidate sequences of one route: tours are stored back to back in
+// a single buffer (one stop index per route stop) and scalar metrics in one
+// column per metric; sorting and filtering only reorder the row indices;
+// tours already in the pool are rejected when added (hash + exact compare)
+class SequencePool {
+    private:
+        DenseRoute dr;
+        std::vector<size_t> tours;
+        std::vector<double> dur, earliness_, lateness_;
+        std::vector<double> max_earliness, max_lateness;
+        std::vector<int> miss_early, miss_late;
+        std::vector<int> sim_macro, sim_micro, sim_nano;
+        std::vector<int> trans_macro, trans_micro, trans_nano;
+        std::vector<size_t> order;          // active rows
+        std::unordered_multimap<uint64_t, size_t> hashes;   // hash -> row
+        std::vector<uint64_t> keys;         // row -> hash
+        size_t attempts_=0;                 // calls to add
+        size_t merged=0;                    // rows dropped by retour
+        static uint64_t hash(const size_t* tour, size_t n);
+    public:
+        static const size_t npos=static_cast<size_t>(-1);
+        SequencePool(const Route& r) : dr(r) {}
+        // returns npos (and stores nothing) if the tour is already pooled
+        size_t add(const std::vector<size_t>& tour);
+        size_t attempts() const {return attempts_;}
+        double duplicationRate() const
+                {return attempts_==0 ? 0 : (1.0*duplicates())/attempts_;}
+        size_t duplicates() const {return attempts_-dur.size()+merged;}
+        double duration(size_t i) const {return dur[i];}
+        bool empty() const {return order.empty();}
+        double earliness(size_t i) const {return earliness_[i];}
+        double lateness(size_t i) const {return lateness_[i];}
+        int nanoSimilarity(size_t i) const {return sim_nano[i];}
+        int nanoTransitions(size_t i) const {return trans_nano[i];}
+        template<class Predicate> void removeIf(Predicate pred) {
+            order.erase(std::remove_if(order.begin(), order.end(), pred),
+                    order.end());
+        }
+        void reserve(size_t n);
+        // re-keys row i after its tour was changed in place; if the tour is
+        // now the one of another pooled row, row i is dropped (returns false);
+        // not thread safe, unlike changing and timing distinct rows
+        bool retour(size_t i);
+        const DenseRoute& route() const {return dr;}
+        const std::vector<size_t>& rows() const {return order;}
+        Sequence sequence(size_t i) const;
+        // timing, similarity and transitions of row i in a single pass
+        void evaluate(size_t i, SequenceEvaluator& ev);
+        void setupTiming(size_t i);
+        double simByTransNano(size_t i) const
+                {return (1.0*sim_nano[i])/trans_nano[i];}
+        size_t size() const {return order.size();}
+        template<class Compare> void sort(Compare comp)
+                {std::sort(order.begin(), order.end(), comp);}
+        std::unordered_map<std::string, double> statistics() const;
+        // per-stop earliness and lateness of row i, by tour position (n
+        // values each); thread safe for distinct buffers
+        void stopTiming(size_t i, double* earliness, double* lateness) const;
+        Sequence summary(size_t i) const;
+        const size_t* tour(size_t i) const {return &tours[i*dr.size()];}
+        // call retour(i) once done changing the tour in place
+        size_t* tour(size_t i) {return &tours[i*dr.size()];}
+};
+
+#endif
@@ -1,87 +1,298 @@
 #include <algorithm>
 #include <iostream>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 #include <limits>
-#include <list>
 #include <numeric>
+#include <queue>
 #include <tuple>
+#include "DenseRoute.h"
 #include "TSPHeuristic.h"
 
 using namespace std;
 
-/*
-TSPSolution TSPHeuristic::cheapestInsertion() const {
-    tuple<size_t,size_t,double> cheapest {0, 0, numeric_limits<double>::max()};
-    for (size_t i=0; i<costs.size(); ++i)
-        for (size_t j=0; j<costs.size(); ++j)
-            if (i!=j && costs[i][j]<get<2>(cheapest))
-                cheapest={i, j, costs[i][j]};
-    list<size_t> tour {get<0>(cheapest), get<1>(cheapest)};
-    list<size_t> pending;
-    for (size_t i=0; i<costs.size(); ++i)
-        if (i!=tour.front() && i!=tour.back())
-            pending.push_back(i);
-    double totcost=costs[tour.front()][tour.back()]
-            +costs[tour.back()][tour.front()];
+// change in the total violation (earliness or lateness) when stops are shifted
+// by d towards their bound: 'count' stops violate it already (the smallest
+// violation is 'minviol') and the closest other one is 'slack' away; exact
+// unless a stop changes between violating and not, then only that closest
+// stop is accounted for (the true change is larger in magnitude)
+static double shiftPenalty(int count, long minviol, long slack, long d,
+        bool& exact) {
+    if (d>=0) {
+        exact=d<=slack;
+        return double(count)*d+max(d-slack, 0L);
+    }
+    exact=-d<=minviol;
+    return -double(count)*min(-d, minviol);
+}
+
+TSPHeuristic::TSPHeuristic(const vector<vector<double>>& csts,
+        Random::Stream rng) : g{rng} {
+    setCosts(csts.size(), [&csts](size_t i, size_t j) {return csts[i][j];});
+}
+
+#if defined(__x86_64__)
+// insertion costs of r before positions p in [from,to) (from>=1), 4 at a time:
+// costs to/from r are gathered from column/row r (to_r/from_r), the cost of
+// the arc currently entering p is arcin[p]; 'best' is replaced by the first
+// position with a strictly smaller cost; returns the first position not done
+__attribute__((target("avx2")))
+static size_t bestInsertionAvx2(const double* to_r, const double* from_r,
+        const double* arcin, const size_t* tour, size_t from, size_t to,
+        size_t& bestpos, double& bestcost) {
+    static_assert(sizeof(size_t)==8, "64-bit tour indices expected");
+    __m256d vbest=_mm256_set1_pd(numeric_limits<double>::max());
+    __m256i vpos=_mm256_setzero_si256();
+    __m256i pos=_mm256_add_epi64(_mm256_set1_epi64x(from),
+            _mm256_set_epi64x(3, 2, 1, 0));
+    const __m256i four=_mm256_set1_epi64x(4);
+    size_t p=from;
+    for (; p+4<=to; p+=4, pos=_mm256_add_epi64(pos, four)) {
+        const __m256i prev=_mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(tour+p-1));
+        const __m256i cur=_mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(tour+p));
+        const __m256d cost=_mm256_sub_pd(_mm256_add_pd(
+                _mm256_i64gather_pd(to_r, prev, 8),
+                _mm256_i64gather_pd(from_r, cur, 8)),
+                _mm256_loadu_pd(arcin+p));
+        const __m256d better=_mm256_cmp_pd(cost, vbest, _CMP_LT_OQ);
+        vbest=_mm256_blendv_pd(vbest, cost, better);
+        vpos=_mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(vpos),
+                _mm256_castsi256_pd(pos), better));
+    }
+    // horizontal arg-min: smallest cost, then first position
+    double lbest[4];
+    size_t lpos[4];
+    _mm256_storeu_pd(lbest, vbest);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lpos), vpos);
+    size_t l=0;
+    for (size_t k=1; k<4; ++k)
+        if (lbest[k]<lbest[l] || (lbest[k]==lbest[l] && lpos[k]<lpos[l]))
+            l=k;
+    if (lbest[l]<bestcost) {
+        bestcost=lbest[l];
+        bestpos=lpos[l];
+    }
+    return p;
+}
+#endif
+
+// a priority queue holds (cost, node, arc tail, arc head) insertions: the best
+// insertion of each pending node is always queued; entries whose arc was
+// split meanwhile are skipped when popped; after inserting v into a->b, the
+// other nodes only need to check the new arcs a->v and v->b, unless their
+// best arc was a->b (full rescan)
+TSPSolution TSPHeuristic::cheapestInsertion(bool fix) {
+    if (tour.empty()) {         // cheapest arc
+        tuple<double, size_t, size_t> cheapest
+                {numeric_limits<double>::max(), 0, 1};
+        for (size_t i=0; i<n; ++i)
+            for (size_t j=0; j<n; ++j)
+                if (i!=j && cost(i, j)<get<0>(cheapest))
+                    cheapest=make_tuple(cost(i, j), i, j);
+        tour={get<1>(cheapest), get<2>(cheapest)};
+        pending.erase(remove_if(pending.begin(), pending.end(), [&](size_t v)
+                {return v==tour[0] || v==tour[1];}), pending.end());
+    }
+    succ.assign(n, n);
+    double totcost=0;
+    for (size_t p=0; p<tour.size(); ++p) {
+        succ[tour[p]]=tour[(p+1)%tour.size()];
+        totcost+=cost(tour[p], succ[tour[p]]);
+    }
+    // fix arcs to/from the first node if 'fix' is set
+    const size_t fixed=fix ? tour[0] : n;
+    typedef tuple<double, size_t, size_t, size_t> Entry;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+    best.assign(n, numeric_limits<double>::max());
+    bestarc.assign(n, n);
+    const auto rescan=[&](size_t v) {
+        best[v]=numeric_limits<double>::max();
+        for (const auto a : tour)
+            if (a!=fixed && succ[a]!=fixed && insertionCost(v, a)<best[v]) {
+                best[v]=insertionCost(v, a);
+                bestarc[v]=a;
+            }
+        if (best[v]==numeric_limits<double>::max())
+            closingArc(v, bestarc[v], best[v]);
+        queue.emplace(best[v], v, bestarc[v], succ[bestarc[v]]);
+    };
+    for (const auto v : pending)
+        rescan(v);
     while (!pending.empty()) {
-        tuple<list<size_t>::iterator, list<size_t>::iterator, double> best
-                {pending.end(), tour.end(), numeric_limits<double>::max()};
-        for (auto it_p=pending.begin(); it_p!=pending.end(); ++it_p)
-            for (auto it_t=tour.begin(); it_t!=tour.end(); ++it_t) {
-                size_t i=it_t==tour.begin()?tour.back():*prev(it_t);
-                double cost=costs[i][*it_p]+costs[*it_p][*it_t]-costs[i][*it_t];
-                if (cost<get<2>(best))
-                    best={it_p, it_t, cost};
+        const Entry e=queue.top();
+        queue.pop();
+        const size_t v=get<1>(e), a=get<2>(e), b=get<3>(e);
+        if (succ[v]!=n || succ[a]!=b)       // inserted already or arc split
+            continue;
+        succ[a]=v;
+        succ[v]=b;
+        tour.push_back(v);
+        totcost+=get<0>(e);
+        pending.erase(find(pending.begin(), pending.end(), v));
+        for (const auto w : pending) {
+            if (bestarc[w]==a) {
+                rescan(w);
+                continue;
             }
-        tour.insert(get<1>(best), *get<0>(best));
-        pending.erase(get<0>(best));
-        totcost+=get<2>(best);
-    }
-    return {vector<size_t>(tour.begin(), tour.end()), totcost};
-}
-*/
-
-/*
-TSPSolution TSPHeuristic::farthestInsertion() const {
-    tuple<size_t, size_t, double> farthest {0, 0, -1};
-    for (size_t i=0; i<costs.size(); ++i)
-        for (size_t j=0; j<costs.size(); ++j)
-            if (i!=j && costs[i][j]>get<2>(farthest))
-                farthest={i, j, costs[i][j]};
-    list<size_t> tour {get<0>(farthest), get<1>(farthest)};
-    list<size_t> pending;
-    for (size_t i=0; i<costs.size(); ++i)
-        if (i!=tour.front() && i!=tour.back())
-            pending.push_back(i);
-    double totcost=costs[tour.front()][tour.back()]
-            +costs[tour.back()][tour.front()];
+            const size_t arcs[2]={a, v};
+            for (const auto x : arcs)
+                if (x!=fixed && succ[x]!=fixed
+                        && insertionCost(w, x)<best[w]) {
+                    best[w]=insertionCost(w, x);
+                    bestarc[w]=x;
+                    queue.emplace(best[w], w, x, succ[x]);
+                }
+        }
+    }
+    return succTour(totcost);
+}
+
+// if all arcs are fixed: the arc closing the tour (into its first node), as
+// in insertPending
+void TSPHeuristic::closingArc(size_t v, size_t& a, double& icost) const {
+    for (const auto x : tour)
+        if (succ[x]==tour[0]) {
+            a=x;
+            icost=insertionCost(v, x);
+        }
+}
+
+// the pending node farthest from the tour (minimum cost from the node to a
+// tour node) is inserted next, at its cheapest position
+TSPSolution TSPHeuristic::farthestInsertion(bool fix) {
+    if (tour.empty()) {         // farthest arc
+        tuple<double, size_t, size_t> farthest {-1, 0, 1};
+        for (size_t i=0; i<n; ++i)
+            for (size_t j=0; j<n; ++j)
+                if (i!=j && cost(i, j)>get<0>(farthest))
+                    farthest=make_tuple(cost(i, j), i, j);
+        tour={get<1>(farthest), get<2>(farthest)};
+        pending.erase(remove_if(pending.begin(), pending.end(), [&](size_t v)
+                {return v==tour[0] || v==tour[1];}), pending.end());
+    }
+    succ.assign(n, n);
+    double totcost=0;
+    for (size_t p=0; p<tour.size(); ++p) {
+        succ[tour[p]]=tour[(p+1)%tour.size()];
+        totcost+=cost(tour[p], succ[tour[p]]);
+    }
+    const size_t fixed=fix ? tour[0] : n;
+    best.assign(n, numeric_limits<double>::max());     // distance to tour
+    for (const auto v : pending)
+        for (const auto u : tour)
+            best[v]=min(best[v], cost(v, u));
     while (!pending.empty()) {
-        // find farthest node
-        tuple<list<size_t>::iterator, double> far {pending.end(), -1};
-        for (auto it_p=pending.begin(); it_p!=pending.end(); ++it_p) {
-            double dist=numeric_limits<double>::max();
-            for (const auto& i : tour)
-                if (costs[*it_p][i]<dist)
-                    dist=costs[*it_p][i];
-            if (dist>get<1>(far))
-                far={it_p, dist};
+        size_t far=0;
+        for (size_t k=1; k<pending.size(); ++k)
+            if (best[pending[k]]>best[pending[far]])
+                far=k;
+        const size_t v=pending[far];
+        pending.erase(pending.begin()+far);
+        size_t bestpos=n;
+        double bestcost=numeric_limits<double>::max();
+        for (const auto a : tour)
+            if (a!=fixed && succ[a]!=fixed && insertionCost(v, a)<bestcost) {
+                bestpos=a;
+                bestcost=insertionCost(v, a);
+            }
+        if (bestpos==n)
+            closingArc(v, bestpos, bestcost);
+        succ[v]=succ[bestpos];
+        succ[bestpos]=v;
+        tour.push_back(v);
+        totcost+=bestcost;
+        for (const auto w : pending)
+            best[w]=min(best[w], cost(w, v));
+    }
+    return succTour(totcost);
+}
+
+// the tour is kept in a contiguous array in the same order as the former
+// std::list; inserting before position p means between tour[p-1] (the last
+// node if p==0) and tour[p]; arcin[p] is the cost of the arc entering p;
+// inserts the (shuffled) pending nodes into the initial tour
+TSPSolution TSPHeuristic::insertPending(bool fix) {
+    arcin.resize(tour.size());
+    double totcost=0;
+    for (size_t p=0; p<tour.size(); ++p) {
+        arcin[p]=costs[(p==0 ? tour.back() : tour[p-1])*n+tour[p]];
+        totcost+=arcin[p];
+    }
+#if defined(__x86_64__)
+    static const bool avx2=__builtin_cpu_supports("avx2");
+#endif
+    // fix arcs to/from the first node (station) if 'fix' is set
+    const size_t first=fix ? 2 : 0;
+    while (!pending.empty()) {
+        size_t r=pending.back();           // random node
+        pending.pop_back();
+        const double* to_r=&costsT[r*n];
+        const double* from_r=&costs[r*n];
+        size_t bestpos=tour.size();
+        double bestcost=numeric_limits<double>::max();
+        size_t p=first;
+        if (p==0) {         // arc from the last node to the first one
+            const double cost=to_r[tour.back()]+from_r[tour[0]]-arcin[0];
+            if (cost<bestcost) {
+                bestpos=0;
+                bestcost=cost;
+            }
+            p=1;
         }
-        size_t p=*get<0>(far);        // farthest node
-        // insert farthest node in the tour
-        tuple<list<size_t>::iterator, double> best
-                {tour.end(), numeric_limits<double>::max()};
-        for (auto it_t=tour.begin(); it_t!=tour.end(); ++it_t) {
-            size_t i=it_t==tour.begin()?tour.back():*prev(it_t);
-            double cost=costs[i][p]+costs[p][*it_t]-costs[i][*it_t];
-            if (cost<get<1>(best))
-                best={it_t, cost};
+#if defined(__x86_64__)
+        if (avx2)
+            p=bestInsertionAvx2(to_r, from_r, arcin.data(), tour.data(), p,
+                    tour.size(), bestpos, bestcost);
+#endif
+        for (; p<tour.size(); ++p) {
+            const double cost=to_r[tour[p-1]]+from_r[tour[p]]-arcin[p];
+            if (cost<bestcost) {
+                bestpos=p;
+                bestcost=cost;
+            }
         }
-        tour.insert(get<0>(best), p);
-        pending.erase(get<0>(far));
-        totcost+=get<1>(best);
+        if (bestpos==tour.size())   // all arcs fixed (2-node guide): append
+            bestcost=to_r[tour.back()]+from_r[tour[0]]-arcin[0];
+        // arcs pred->r and r->tour[bestpos] (the first node if appended)
+        const size_t pred=bestpos==0 ? tour.back() : tour[bestpos-1];
+        arcin[bestpos<tour.size() ? bestpos : 0]=
+                from_r[tour[bestpos<tour.size() ? bestpos : 0]];
+        tour.insert(tour.begin()+bestpos, r);
+        arcin.insert(arcin.begin()+bestpos, to_r[pred]);
+        totcost+=bestcost;
+    }
+    return {tour, totcost};
+}
+
+TSPSolution TSPHeuristic::insertion(Insertion ins,
+        const vector<size_t>& guide, bool fix) {
+    if (ins==Insertion::timeWindows && dr==nullptr) {
+        cout<<"warning: no time windows set: random insertion"<<endl;
+        ins=Insertion::random;
+    }
+    if (ins==Insertion::timeWindows) {
+        // timing starts at the station: by default the only guide node
+        if (guide.empty())
+            setGuide({static_cast<size_t>(find(dense.begin(), dense.end(),
+                    dr->station())-dense.begin())});
+        else
+            setGuide(guide);
+        if (tour[0]>=n || dense[tour[0]]!=dr->station())
+            cout<<"warning: the guide does not start at the station"<<endl;
+        shuffle(pending.begin(), pending.end(), g);
+        return timeWindowInsertion(fix && !guide.empty());
     }
-    return {vector<size_t>(tour.begin(), tour.end()), totcost};
+    if (ins==Insertion::random)
+        return guide.empty() ? randomInsertion(0, false)
+                : randomInsertion(guide, fix);
+    setGuide(guide);
+    if (ins==Insertion::cheapest)
+        return cheapestInsertion(fix && !guide.empty());
+    return farthestInsertion(fix && !guide.empty());
 }
-*/
 
 vector<TSPSolution> TSPHeuristic::pool(size_t n, size_t guide, bool fix) {
     vector<TSPSolution> pool_;
@@ -92,67 +303,178 @@ vector<TSPSolution> TSPHeuristic::pool(size_t n, size_t guide, bool fix) {
 }
 
 TSPSolution TSPHeuristic::randomInsertion(size_t guide, bool fix) {
-    if (guide==1 || guide>costs.size())
+    if (guide==1 || guide>n)
         cout<<"warning: invalid guide value"<<endl;
-    vector<size_t> pending(costs.size()-guide);
+    pending.resize(n-guide);
     iota(pending.begin(), pending.end(), guide);
     shuffle(pending.begin(), pending.end(), g);
-    list<size_t> tour;
-    double totcost=0;
+    tour.clear();
+    tour.reserve(n);
     if (guide==0) {
         tour={pending.end()[-1], pending.end()[-2]};
         pending.resize(pending.size()-2);
-        totcost=costs[tour.front()][tour.back()]
-                +costs[tour.back()][tour.front()];
     } else {
         for (size_t i=0; i<guide; ++i)
             tour.push_back(i);
-        for (size_t i=0; i<guide; ++i)
-            totcost+=costs[i==0?guide-1:i-1][i];
-    }
-    while (!pending.empty()) {
-        size_t r=pending.back();           // random node
-        pending.pop_back();
-        tuple<list<size_t>::iterator, double> best
-                {tour.end(), numeric_limits<double>::max()};
-        // fix arcs to/from station if there is a guide and 'fix' is set
-        for (auto it_t = guide!=0 && fix ? next(tour.begin(),2) : tour.begin();
-                it_t!=tour.end(); ++it_t) { // TODO: bounds checking on 'next'
-            size_t i=it_t==tour.begin()?tour.back():*prev(it_t);
-            double cost=costs[i][r]+costs[r][*it_t]-costs[i][*it_t];
-            if (cost<get<1>(best))
-                best={it_t, cost};
-        }
-        tour.insert(get<0>(best), r);
-        totcost+=get<1>(best);
     }
-    return {vector<size_t>(tour.begin(), tour.end()), totcost};
+    return insertPending(guide!=0 && fix);
 }
 
-/*
-TSPSolution TSPHeuristic::randomInsertion() {
-    vector<size_t> pending(costs.size());
-    iota(pending.begin(), pending.end(), 0);
+TSPSolution TSPHeuristic::randomInsertion(const vector<size_t>& guide,
+        bool fix) {
+    if (guide.size()<2)
+        cout<<"warning: invalid guide"<<endl;
+    setGuide(guide);
     shuffle(pending.begin(), pending.end(), g);
-    list<size_t> tour {pending.end()[-1], pending.end()[-2]};
-    pending.resize(pending.size()-2);
-    double totcost=costs[tour.front()][tour.back()]
-            +costs[tour.back()][tour.front()];
+    return insertPending(fix);
+}
+
+// tour: the guide nodes, pending: all other nodes (in index order)
+void TSPHeuristic::setGuide(const vector<size_t>& guide) {
+    if (guide.size()>n)
+        cout<<"warning: invalid guide"<<endl;
+    inguide.assign(n, false);
+    for (const auto i : guide) {
+        if (i>=n || inguide[i])
+            cout<<"warning: invalid guide node"<<endl;
+        else
+            inguide[i]=true;
+    }
+    pending.clear();
+    for (size_t i=0; i<n; ++i)
+        if (!inguide[i])
+            pending.push_back(i);
+    tour.clear();
+    tour.reserve(n);
+    tour.insert(tour.end(), guide.begin(), guide.end());
+}
+
+void TSPHeuristic::setTimeWindows(const DenseRoute& r, vector<size_t> dense,
+        double weight) {
+    if (dense.size()!=n)
+        cout<<"warning: invalid stop indices"<<endl;
+    dr=&r;
+    this->dense=move(dense);
+    twweight=weight;
+}
+
+// tour in arc order from its first node
+TSPSolution TSPHeuristic::succTour(double totcost) const {
+    vector<size_t> ordered;
+    ordered.reserve(tour.size());
+    size_t v=tour[0];
+    do {
+        ordered.push_back(v);
+        v=succ[v];
+    } while (v!=tour[0]);
+    return {ordered, totcost};
+}
+
+// as insertPending but the cost of a position also includes the weighted
+// change in earliness and lateness (twDelta); the tour is timed from its first
+// node (the station), so a node inserted before it is appended instead
+TSPSolution TSPHeuristic::timeWindowInsertion(bool fix) {
+    double totcost=0;
+    for (size_t p=0; p<tour.size(); ++p)
+        totcost+=cost(tour[p], tour[(p+1)%tour.size()]);
+    updateWindows(1);
+    // fix arcs to/from the first node (station) if 'fix' is set
+    const size_t first=fix ? 2 : 1;
     while (!pending.empty()) {
-        size_t r=pending.back();           // random node
+        const size_t r=pending.back();      // random node
         pending.pop_back();
-        tuple<list<size_t>::iterator, double> best
-                {tour.end(), numeric_limits<double>::max()};
-        for (auto it_t=tour.begin(); it_t!=tour.end(); ++it_t) {
-            size_t i=it_t==tour.begin()?tour.back():*prev(it_t);
-            double cost=costs[i][r]+costs[r][*it_t]-costs[i][*it_t];
-            if (cost<get<1>(best))
-                best={it_t, cost};
+        const size_t last=fix ? tour.size()-1 : tour.size();
+        // appended if all arcs are fixed
+        size_t bestpos=tour.size();
+        double bestins=cost(tour.back(), r)+cost(r, tour[0])
+                -cost(tour.back(), tour[0]);
+        double bestcost=numeric_limits<double>::max();
+        for (size_t p=first; p<=last; ++p) {
+            const size_t a=tour[p-1], b=tour[p%tour.size()];
+            const double ins=cost(a, r)+cost(r, b)-cost(a, b);
+            const double c=ins+twweight*twDelta(r, p).total();
+            if (c<bestcost) {
+                bestpos=p;
+                bestins=ins;
+                bestcost=c;
+            }
         }
-        tour.insert(get<0>(best), r);
-        totcost+=get<1>(best);
+        tour.insert(tour.begin()+bestpos, r);
+        totcost+=bestins;
+        updateWindows(bestpos);
     }
-    return {vector<size_t>(tour.begin(), tour.end()), totcost};
+    return {tour, totcost};
 }
-*/
 
+// change in earliness plus lateness if v is inserted before position p (p>=1,
+// appended if p==tour.size()): the penalty of v and the shift of the arrivals
+// from p on (see shiftPenalty), in O(1) from the aggregates of win[p]
+TSPHeuristic::TWDelta TSPHeuristic::twDelta(size_t v, size_t p) const {
+    const size_t s=dense[v], a=dense[tour[p-1]];
+    const long ae=win[p-1].dep_e+dr->earlyTravelTime(a, s);
+    const long al=win[p-1].dep_l+dr->lateTravelTime(a, s);
+    TWDelta delta{0, 0, 0, true, true};
+    if (dr->hasTW(s))
+        delta.own=max(dr->startTW(s)-ae, 0L)+max(al-dr->endTW(s), 0L);
+    if (p==tour.size())
+        return delta;
+    const size_t b=dense[tour[p]];
+    const Window& w=win[p];
+    const long se=ae+dr->earlyServiceTime(s)+dr->earlyTravelTime(s, b)-w.arr_e;
+    const long sl=al+dr->lateServiceTime(s)+dr->lateTravelTime(s, b)-w.arr_l;
+    delta.late=shiftPenalty(w.late, w.minlate, w.slack_l, sl, delta.exact_late);
+    // later arrivals reduce earliness
+    delta.early=shiftPenalty(w.early, w.minearly, w.slack_e, -se,
+            delta.exact_early);
+    return delta;
+}
+
+TSPHeuristic::TWDelta TSPHeuristic::timeWindowDelta(
+        const vector<size_t>& partial, size_t v, size_t p) {
+    tour=partial;
+    updateWindows(1);
+    return twDelta(v, p);
+}
+
+// arrivals and departures from position 'from' on, then the time window
+// aggregates of all positions (backwards)
+void TSPHeuristic::updateWindows(size_t from) {
+    const long inf=numeric_limits<long>::max();
+    const Window none={0, 0, 0, 0, 0, 0, inf, inf, inf, inf};
+    win.resize(tour.size());
+    win[0]=none;
+    for (size_t p=max(from, size_t(1)); p<tour.size(); ++p) {
+        const size_t prev=dense[tour[p-1]], s=dense[tour[p]];
+        Window& w=win[p];
+        w.arr_e=win[p-1].dep_e+dr->earlyTravelTime(prev, s);
+        w.arr_l=win[p-1].dep_l+dr->lateTravelTime(prev, s);
+        w.dep_e=w.arr_e+dr->earlyServiceTime(s);
+        w.dep_l=w.arr_l+dr->lateServiceTime(s);
+    }
+    for (size_t p=tour.size()-1; p>=1; --p) {
+        Window& w=win[p];
+        const Window& next=p+1<tour.size() ? win[p+1] : none;
+        w.early=next.early;
+        w.late=next.late;
+        w.minearly=next.minearly;
+        w.minlate=next.minlate;
+        w.slack_e=next.slack_e;
+        w.slack_l=next.slack_l;
+        const size_t s=dense[tour[p]];
+        if (!dr->hasTW(s))
+            continue;
+        const long e=dr->startTW(s)-w.arr_e, l=w.arr_l-dr->endTW(s);
+        if (e>0) {
+            ++w.early;
+            w.minearly=min(w.minearly, e);
+        } else {
+            w.slack_e=min(w.slack_e, -e);
+        }
+        if (l>0) {
+            ++w.late;
+            w.minlate=min(w.minlate, l);
+        } else {
+            w.slack_l=min(w.slack_l, -l);
+        }
+    }
+}
@@ -1,23 +1,99 @@
 #ifndef tspheuristic_h
 #define tspheuristic_h
 
-#include <random>
 #include <vector>
+#include "Random.h"
 #include "TSPSolution.h"
 
+class DenseRoute;
 class TSPHeuristic {
+    public:
+        enum class Insertion {cheapest, farthest, random, timeWindows};
+        // time window part of an insertion: penalty of the inserted node and
+        // the change in lateness and earliness of the nodes after it; each
+        // change is exact unless a shifted node changes between violating its
+        // window and not, then the true change has the same sign and is
+        // larger in magnitude
+        class TWDelta {
+            public:
+                double own, late, early;
+                bool exact_late, exact_early;
+                double total() const {return own+late+early;}
+        };
     private:
-        std::vector<std::vector<double>> costs;
-        std::random_device rd;
-        std::mt19937 g;
-        TSPSolution cheapestInsertion() const;
-        TSPSolution farthestInsertion() const;
+        // no-wait timing along the tour from the station (see
+        // TimingEvaluator) and time window aggregates from each position on
+        struct Window {
+            long arr_e, arr_l, dep_e, dep_l;
+            int early, late;            // early/late TW stops
+            long minearly, minlate;     // smallest earliness/lateness
+            long slack_e, slack_l;      // smallest margin to become early/late
+        };
+        size_t n;
+        std::vector<double> costs, costsT;      // row-major n x n (transposed)
+        Random::Stream g;
+        const DenseRoute* dr=nullptr;           // time windows (optional)
+        std::vector<size_t> dense;              // node -> index of dr
+        double twweight=1;
+        // workspace (reused across calls)
+        std::vector<size_t> pending, tour;
+        std::vector<double> arcin;
+        std::vector<bool> inguide;
+        std::vector<size_t> succ, bestarc;  // cheapest/farthest insertion
+        std::vector<double> best;
+        std::vector<Window> win;                // time window insertion
+        // tour: nodes in insertion order, arcs a->succ[a]
+        double cost(size_t i, size_t j) const {return costs[i*n+j];}
+        double insertionCost(size_t v, size_t a) const
+                {return cost(a, v)+cost(v, succ[a])-cost(a, succ[a]);}
+        TSPSolution cheapestInsertion(bool fix);
+        void closingArc(size_t v, size_t& a, double& icost) const;
+        TSPSolution farthestInsertion(bool fix);
+        TSPSolution insertPending(bool fix);
+        void setGuide(const std::vector<size_t>& guide);
+        TSPSolution succTour(double totcost) const;
+        TSPSolution timeWindowInsertion(bool fix);
+        TWDelta twDelta(size_t v, size_t p) const;
+        void updateWindows(size_t from);
     public:
-        TSPHeuristic(std::vector<std::vector<double>> csts)
-                : costs{std::move(csts)}, g(rd()) {}
+        TSPHeuristic(const std::vector<std::vector<double>>& csts,
+                Random::Stream rng);
+        // no nodes yet (see setCosts)
+        explicit TSPHeuristic(Random::Stream rng) : n{0}, g{rng} {}
         std::vector<TSPSolution> pool(size_t n, size_t guide, bool fix);
         TSPSolution randomInsertion(size_t guide, bool fix);
+        // the guide tour is given by node indices (e.g. station, entry, exit)
+        // so the same solver can be reused for different guides
+        TSPSolution randomInsertion(const std::vector<size_t>& guide, bool fix);
+        // cheapest/farthest insertion are deterministic; an empty guide
+        // starts from the cheapest/farthest (random) pair of nodes
+        TSPSolution insertion(Insertion ins, const std::vector<size_t>& guide,
+                bool fix);
+        // replaces the instance by m nodes with costs cost(i,j), reusing the
+        // buffers of the previous one (time windows are cleared)
+        template<class Cost> void setCosts(size_t m, Cost cost) {
+            n=m;
+            costs.resize(n*n);
+            costsT.resize(n*n);
+            for (size_t i=0; i<n; ++i)
+                for (size_t j=0; j<n; ++j)
+                    costs[i*n+j]=costsT[j*n+i]=cost(i, j);
+            dr=nullptr;
+        }
+        // e.g. one stream per solved instance, independent of the instances
+        // solved before
+        void setStream(Random::Stream rng) {g=rng;}
+        // time windows of dr (dense: node -> stop index of dr) for
+        // Insertion::timeWindows; earliness and lateness seconds are weighted
+        // by 'weight' against the insertion costs
+        void setTimeWindows(const DenseRoute& r, std::vector<size_t> dense,
+                double weight);
         TSPSolution solve();
+        // time window part of inserting v before position p (1<=p<=size) of
+        // a partial tour from the station, as judged by Insertion::timeWindows
+        // (see setTimeWindows)
+        TWDelta timeWindowDelta(const std::vector<size_t>& partial, size_t v,
+                size_t p);
 };
 
 #endif
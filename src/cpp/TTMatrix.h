@@ -22,6 +22,8 @@ class TTMatrix {
                     }
             return true;
         }
+        size_t index(const std::string& stopid) const
+                {return str_to_idx.at(stopid);}
         TTMatrix normalize() const;
         void setTravelTime(const std::string& from, const std::string& to,
                 double t) {
@@ -35,6 +37,7 @@ class TTMatrix {
                 std::cout<<"warning: index out of range"<<std::endl;
             ttimes[idx_from][idx_to]=t;
         }
+        size_t size() const {return ttimes.size();}
         double travelTime(const std::string& from, const std::string& to)
                 const {
             if (str_to_idx.count(from)==0)
@@ -45,6 +48,8 @@ class TTMatrix {
                         <<std::endl;
             return ttimes[str_to_idx.at(from)][str_to_idx.at(to)];
         }
+        double travelTime(size_t from, size_t to) const
+                {return ttimes[from][to];}
 };
 
 #endif
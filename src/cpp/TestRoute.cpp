@@ -2,6 +2,7 @@
 #include <iostream>
 #include <unordered_set>
 #include "AlgoInput.h"
+#include "FeatureRegistry.h"
 #include "TestRoute.h"
 #include "TSPHeuristic.h"
 
@@ -12,8 +13,14 @@ unordered_map<string, double> TestRoute::features(const AlgoInput& input) const{
     const auto& r=*this;
     // station (one-hot encoding)
     features.insert({r.station(), 1});
-    // number of dropoff stops
-    features.insert({"n_stops", r.stops().size()-1});
+    // route features shared with the evaluation model (no pool statistics)
+    typedef FeatureRegistry FR;
+    const FR::Stats nostats;
+    double rt[FR::RT_SERVICE_TIME+1];
+    for (size_t f=0; f<=FR::RT_SERVICE_TIME; ++f) {
+        rt[f]=FR::routeFns[f](r, nostats, rt);
+        features.insert({FR::routeNames[f], rt[f]});
+    }
     // number of overlapping routes in algoinput (varying ranges)
     const double eps=1e-10;
     features.insert({"p_olaps_0.80-1.00",input.ratioOverlaps(r,0.80+eps,1.00)});
@@ -22,25 +29,6 @@ unordered_map<string, double> TestRoute::features(const AlgoInput& input) const{
     features.insert({"p_olaps_0.65-1.00",input.ratioOverlaps(r,0.65+eps,1.00)});
     features.insert({"p_olaps_0.50-1.00",input.ratioOverlaps(r,0.50+eps,1.00)});
     features.insert({"p_olaps_0.25-1.00",input.ratioOverlaps(r,0.25+eps,1.00)});
-    // time windows: total number (varying lengths) and percentage
-    features.insert({"n_tws", r.countTimeWindows(0, 361)});
-    features.insert({"p_tws", features.at("n_tws")/features.at("n_stops")});
-    features.insert({"n_strict_tws", r.countTimeWindows(0, 241)});
-    features.insert({"p_strict_tws", features.at("n_strict_tws")
-            /features.at("n_stops")});
-    // distance from the station to the nearest dropoff stop
-    features.insert({"dropoff_nearest", r.distanceNearestDropoff()});
-    // area of the dropoff stops bounding rectangle
-    features.insert({"dropoff_area", r.rectangle().area()});
-    // dropoff density (dropoffs per unit of area)
-    features.insert({"dropoff_density",
-            features.at("n_stops")/features.at("dropoff_area")});
-    // number of packages: total and avg. per stop
-    features.insert({"n_packs", r.numPackages()});
-    features.insert({"packs_per_stop", features.at("n_packs")
-            /features.at("n_stops")});
-    // total service time
-    features.insert({"service_time", r.serviceTime()});
     // basis expansion: only between station feature and other features
     unordered_map<string, double> expansion;
     for (const auto& kv : features)
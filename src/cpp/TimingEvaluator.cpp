@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <iostream>
+#include "Sequence.h"
+#include "TimingEvaluator.h"
+
+using namespace std;
+
+TimingEvaluator::TimingEvaluator(const DenseRoute& r, vector<size_t> tour)
+        : dr(r), tour_{move(tour)} {
+    const size_t n=tour_.size();
+    if (n==0 || tour_[0]!=dr.station())
+        cout<<"warning: invalid sequence"<<endl;
+    arr_e.assign(n, 0);
+    arr_l.assign(n, 0);
+    dep_e.assign(n, 0);
+    dep_l.assign(n, 0);
+    bwd_e.assign(n, 0);
+    bwd_l.assign(n, 0);
+    fwd_tt.assign(n, 0);
+    bwd_tt.assign(n, 0);
+    pre_e.assign(n, 0);
+    pre_l.assign(n, 0);
+    pre_max_e.assign(n, 0);
+    pre_max_l.assign(n, 0);
+    suf_max_e.assign(n+1, 0);
+    suf_max_l.assign(n+1, 0);
+    pre_miss_e.assign(n, 0);
+    pre_miss_l.assign(n, 0);
+    nexttw.assign(n+1, 0);
+    update(1);
+}
+
+void TimingEvaluator::applyRelocate(size_t i, size_t j) {
+    if (i<j)
+        rotate(tour_.begin()+i, tour_.begin()+i+1, tour_.begin()+j+1);
+    else if (j<i)
+        rotate(tour_.begin()+j, tour_.begin()+i, tour_.begin()+i+1);
+    update(min(i, j));
+}
+
+void TimingEvaluator::applySwap(size_t i, size_t j) {
+    swap(tour_[i], tour_[j]);
+    update(min(i, j));
+}
+
+void TimingEvaluator::applyTwoOpt(size_t i, size_t j) {
+    reverse(tour_.begin()+i, tour_.begin()+j+1);
+    update(i);
+}
+
+TimingEvaluator::Timing TimingEvaluator::evaluate(size_t first,
+        const Segment* segs, size_t nsegs) const {
+    // positions 0..first-1 are unchanged: take their metrics from the prefixes
+    const size_t n=tour_.size();
+    Timing t;
+    t.duration=fwd_tt[first-1];
+    t.earliness=pre_e[first-1];
+    t.lateness=pre_l[first-1];
+    t.max_earliness=pre_max_e[first-1];
+    t.max_lateness=pre_max_l[first-1];
+    t.miss_early=pre_miss_e[first-1];
+    t.miss_late=pre_miss_l[first-1];
+    size_t last=tour_[first-1];
+    long de=dep_e[first-1], dl=dep_l[first-1];
+    for (size_t k=0; k<nsegs; ++k) {
+        const auto& sg=segs[k];
+        const size_t head=sg.reversed?tour_[sg.to]:tour_[sg.from];
+        t.duration+=dr.travelTime(last, head);
+        const long ae=de+dr.earlyTravelTime(last, head);
+        const long al=dl+dr.lateTravelTime(last, head);
+        if (!sg.reversed) {
+            // arrivals within the segment are shifted by a constant
+            const long se=ae-arr_e[sg.from], sl=al-arr_l[sg.from];
+            t.duration+=fwd_tt[sg.to]-fwd_tt[sg.from];
+            last=tour_[sg.to];
+            de=dep_e[sg.to]+se;
+            dl=dep_l[sg.to]+sl;
+            if (se==0 && sl==0 && sg.to==n-1) {     // back in sync
+                t.earliness+=pre_e[n-1]-pre_e[sg.from-1];
+                t.lateness+=pre_l[n-1]-pre_l[sg.from-1];
+                t.miss_early+=pre_miss_e[n-1]-pre_miss_e[sg.from-1];
+                t.miss_late+=pre_miss_l[n-1]-pre_miss_l[sg.from-1];
+                t.max_earliness=max(t.max_earliness, suf_max_e[sg.from]);
+                t.max_lateness=max(t.max_lateness, suf_max_l[sg.from]);
+                continue;
+            }
+            for (size_t w=nexttw[sg.from]; w<twpos.size()&&twpos[w]<=sg.to;
+                    ++w) {
+                const size_t q=twpos[w];
+                visitEarly(t, arr_e[q]+se, dr.startTW(tour_[q]));
+                visitLate(t, arr_l[q]+sl, dr.endTW(tour_[q]));
+            }
+        } else {
+            // arrival at position q is ae+bwd[to]-bwd[q]
+            for (size_t w=nexttw[sg.from]; w<twpos.size()&&twpos[w]<=sg.to;
+                    ++w) {
+                const size_t q=twpos[w];
+                visitEarly(t, ae+bwd_e[sg.to]-bwd_e[q], dr.startTW(tour_[q]));
+                visitLate(t, al+bwd_l[sg.to]-bwd_l[q], dr.endTW(tour_[q]));
+            }
+            t.duration+=bwd_tt[sg.to]-bwd_tt[sg.from];
+            last=tour_[sg.from];
+            de=ae+bwd_e[sg.to]-bwd_e[sg.from]+dr.earlyServiceTime(last);
+            dl=al+bwd_l[sg.to]-bwd_l[sg.from]+dr.lateServiceTime(last);
+        }
+    }
+    t.duration+=dr.travelTime(last, tour_[0]);      // back to station
+    return t;
+}
+
+TimingEvaluator::Timing TimingEvaluator::evaluateRelocate(size_t i, size_t j)
+        const {
+    const size_t n=tour_.size();
+    Segment segs[3];
+    size_t nsegs=0;
+    if (i<j) {
+        segs[nsegs++]={i+1, j, false};
+        segs[nsegs++]={i, i, false};
+    } else if (j<i) {
+        segs[nsegs++]={i, i, false};
+        segs[nsegs++]={j, i-1, false};
+    } else
+        return timing();
+    const size_t last=max(i, j);
+    if (last+1<n)
+        segs[nsegs++]={last+1, n-1, false};
+    return evaluate(min(i, j), segs, nsegs);
+}
+
+TimingEvaluator::Timing TimingEvaluator::evaluateSwap(size_t i, size_t j)
+        const {
+    if (i==j)
+        return timing();
+    if (j<i)
+        swap(i, j);
+    const size_t n=tour_.size();
+    Segment segs[4];
+    size_t nsegs=0;
+    segs[nsegs++]={j, j, false};
+    if (j>i+1)
+        segs[nsegs++]={i+1, j-1, false};
+    segs[nsegs++]={i, i, false};
+    if (j+1<n)
+        segs[nsegs++]={j+1, n-1, false};
+    return evaluate(i, segs, nsegs);
+}
+
+TimingEvaluator::Timing TimingEvaluator::evaluateTwoOpt(size_t i, size_t j)
+        const {
+    const size_t n=tour_.size();
+    Segment segs[2];
+    size_t nsegs=0;
+    segs[nsegs++]={i, j, true};
+    if (j+1<n)
+        segs[nsegs++]={j+1, n-1, false};
+    return evaluate(i, segs, nsegs);
+}
+
+void TimingEvaluator::setupTiming(Sequence& seq) const {
+    const auto t=timing();
+    vector<double> st_earliness(tour_.size()), st_lateness(tour_.size());
+    for (size_t p=0; p<tour_.size(); ++p) {
+        st_earliness[p]=stopEarliness(p);
+        st_lateness[p]=stopLateness(p);
+    }
+    seq.setDuration(t.duration);
+    seq.setEarliness(t.earliness);
+    seq.setLateness(t.lateness);
+    seq.setStopEarliness(move(st_earliness));
+    seq.setStopLateness(move(st_lateness));
+    seq.setEarlyArrivals(t.miss_early);
+    seq.setLateArrivals(t.miss_late);
+    seq.setMaxEarliness(t.max_earliness);
+    seq.setMaxLateness(t.max_lateness);
+}
+
+double TimingEvaluator::stopEarliness(size_t p) const {
+    const size_t s=tour_[p];
+    return p>0 && dr.hasTW(s) && arr_e[p]<dr.startTW(s)
+            ? dr.startTW(s)-arr_e[p] : 0;
+}
+
+double TimingEvaluator::stopLateness(size_t p) const {
+    const size_t s=tour_[p];
+    return p>0 && dr.hasTW(s) && arr_l[p]>dr.endTW(s)
+            ? arr_l[p]-dr.endTW(s) : 0;
+}
+
+TimingEvaluator::Timing TimingEvaluator::timing() const {
+    const size_t n=tour_.size();
+    Timing t;
+    t.duration=fwd_tt[n-1]+dr.travelTime(tour_[n-1], tour_[0]);
+    t.earliness=pre_e[n-1];
+    t.lateness=pre_l[n-1];
+    t.max_earliness=pre_max_e[n-1];
+    t.max_lateness=pre_max_l[n-1];
+    t.miss_early=pre_miss_e[n-1];
+    t.miss_late=pre_miss_l[n-1];
+    return t;
+}
+
+// single pass over a tour, as Route::setupTiming (no prefix arrays kept)
+TimingEvaluator::Timing TimingEvaluator::timing(const DenseRoute& r,
+        const size_t* tour, size_t n, double* st_earliness,
+        double* st_lateness) {
+    Timing t;
+    long tp_e=0, tp_l=0;
+    if (st_earliness!=nullptr)
+        st_earliness[0]=0;
+    if (st_lateness!=nullptr)
+        st_lateness[0]=0;
+    for (size_t i=1; i<n; ++i) {
+        const size_t prev=tour[i-1], s=tour[i];
+        t.duration+=r.travelTime(prev, s);
+        tp_e+=r.earlyTravelTime(prev, s);
+        tp_l+=r.lateTravelTime(prev, s);
+        double e=0, l=0;
+        if (r.hasTW(s)) {
+            if (tp_e<r.startTW(s))
+                e=r.startTW(s)-tp_e;
+            if (tp_l>r.endTW(s))
+                l=tp_l-r.endTW(s);
+            visitEarly(t, tp_e, r.startTW(s));
+            visitLate(t, tp_l, r.endTW(s));
+        }
+        if (st_earliness!=nullptr)
+            st_earliness[i]=e;
+        if (st_lateness!=nullptr)
+            st_lateness[i]=l;
+        tp_e+=r.earlyServiceTime(s);
+        tp_l+=r.lateServiceTime(s);
+    }
+    t.duration+=r.travelTime(tour[n-1], tour[0]);   // back to station
+    return t;
+}
+
+void TimingEvaluator::update(size_t first) {
+    const size_t n=tour_.size();
+    for (size_t p=first; p<n; ++p) {
+        const size_t prev=tour_[p-1], s=tour_[p];
+        arr_e[p]=dep_e[p-1]+dr.earlyTravelTime(prev, s);
+        arr_l[p]=dep_l[p-1]+dr.lateTravelTime(prev, s);
+        dep_e[p]=arr_e[p]+dr.earlyServiceTime(s);
+        dep_l[p]=arr_l[p]+dr.lateServiceTime(s);
+        bwd_e[p]=bwd_e[p-1]+dr.earlyServiceTime(s)+dr.earlyTravelTime(s, prev);
+        bwd_l[p]=bwd_l[p-1]+dr.lateServiceTime(s)+dr.lateTravelTime(s, prev);
+        fwd_tt[p]=fwd_tt[p-1]+dr.travelTime(prev, s);
+        bwd_tt[p]=bwd_tt[p-1]+dr.travelTime(s, prev);
+        const double e=stopEarliness(p), l=stopLateness(p);
+        pre_e[p]=pre_e[p-1]+e;
+        pre_l[p]=pre_l[p-1]+l;
+        pre_miss_e[p]=pre_miss_e[p-1]+(e>0?1:0);
+        pre_miss_l[p]=pre_miss_l[p-1]+(l>0?1:0);
+        pre_max_e[p]=max(pre_max_e[p-1], e);
+        pre_max_l[p]=max(pre_max_l[p-1], l);
+    }
+    twpos.clear();
+    for (size_t p=n; p-->0;) {
+        suf_max_e[p]=max(suf_max_e[p+1], stopEarliness(p));
+        suf_max_l[p]=max(suf_max_l[p+1], stopLateness(p));
+    }
+    for (size_t p=0; p<n; ++p) {
+        nexttw[p]=twpos.size();
+        if (p>0 && dr.hasTW(tour_[p]))
+            twpos.push_back(p);
+    }
+    nexttw[n]=twpos.size();
+}
@@ -0,0 +1,83 @@
+#ifndef timingevaluator_h
+#define timingevaluator_h
+
+#include <vector>
+#include "DenseRoute.h"
+
+class Sequence;
+// keeps prefix arrival times of a tour (same worst-case early/late model as
+// Route::setupTiming) such that the timing of swap, relocate and 2-opt moves
+// can be queried without rebuilding the tour: duration in O(1), time window
+// metrics in O(1) plus the number of time window stops whose arrival shifts
+class TimingEvaluator {
+    public:
+        class Timing {
+            public:
+                double duration=0;
+                double earliness=0, lateness=0;
+                double max_earliness=0, max_lateness=0;
+                int miss_early=0, miss_late=0;
+                double cost() const {return duration+earliness+lateness;}
+        };
+    private:
+        class Segment {     // positions [from,to] of the current tour
+            public:
+                size_t from, to;
+                bool reversed;
+        };
+        const DenseRoute& dr;
+        std::vector<size_t> tour_;
+        // arrival/departure times at each position (early and late chains)
+        std::vector<long> arr_e, arr_l, dep_e, dep_l;
+        // accumulated service+travel times when traversing the tour backwards
+        std::vector<long> bwd_e, bwd_l;
+        // accumulated travel times (forwards and backwards)
+        std::vector<double> fwd_tt, bwd_tt;
+        // prefix (up to and including position) and suffix metrics
+        std::vector<double> pre_e, pre_l, pre_max_e, pre_max_l;
+        std::vector<double> suf_max_e, suf_max_l;
+        std::vector<int> pre_miss_e, pre_miss_l;
+        std::vector<size_t> twpos;      // positions of stops with time window
+        std::vector<size_t> nexttw;     // index in twpos of 1st position >= p
+        Timing evaluate(size_t first, const Segment* segs, size_t nsegs) const;
+        void update(size_t first);
+        static void visitEarly(Timing& t, long arrival, long start) {
+            if (arrival<start) {
+                double e=start-arrival;
+                t.earliness+=e;
+                t.miss_early++;
+                if (e>t.max_earliness)
+                    t.max_earliness=e;
+            }
+        }
+        static void visitLate(Timing& t, long arrival, long end) {
+            if (arrival>end) {
+                double l=arrival-end;
+                t.lateness+=l;
+                t.miss_late++;
+                if (l>t.max_lateness)
+                    t.max_lateness=l;
+            }
+        }
+    public:
+        TimingEvaluator(const DenseRoute& r, std::vector<size_t> tour);
+        TimingEvaluator(const DenseRoute& r, const Sequence& seq)
+                : TimingEvaluator(r, r.toTour(seq)) {}
+        void applyRelocate(size_t i, size_t j);
+        void applySwap(size_t i, size_t j);
+        void applyTwoOpt(size_t i, size_t j);
+        // position i moves to position j (all positions must be >= 1)
+        Timing evaluateRelocate(size_t i, size_t j) const;
+        Timing evaluateSwap(size_t i, size_t j) const;
+        // reverses positions i..j (i<j)
+        Timing evaluateTwoOpt(size_t i, size_t j) const;
+        double stopEarliness(size_t p) const;
+        double stopLateness(size_t p) const;
+        void setupTiming(Sequence& seq) const;
+        Timing timing() const;
+        static Timing timing(const DenseRoute& r, const size_t* tour, size_t n,
+                double* st_earliness=nullptr, double* st_lateness=nullptr);
+        const std::vector<size_t>& tour() const {return tour_;}
+};
+
+#endif
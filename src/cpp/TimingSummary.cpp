@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <limits>
+#include "DenseRoute.h"
+#include "TimingSummary.h"
+
+using namespace std;
+
+static const long inf=numeric_limits<long>::max();
+
+TimingSummary TimingSummary::after(const DenseRoute& dr,
+        const TimingSummary& a, size_t s) {
+    return stop(dr, s, a.ref_e+a.span_e+dr.earlyTravelTime(a.last, s),
+            a.ref_l+a.span_l+dr.lateTravelTime(a.last, s));
+}
+
+// a single stop is timed exactly
+TimingSummary TimingSummary::concat(const DenseRoute& dr,
+        const TimingSummary& a, TimingSummary b) {
+    const long ae=a.ref_e+a.span_e+dr.earlyTravelTime(a.last, b.first);
+    const long al=a.ref_l+a.span_l+dr.lateTravelTime(a.last, b.first);
+    if (b.first==b.last)
+        b=stop(dr, b.first, ae, al);
+    else
+        b.shift(ae-b.ref_e, al-b.ref_l);
+    TimingSummary s=a;
+    s.last=b.last;
+    s.duration+=dr.travelTime(a.last, b.first)+b.duration;
+    s.span_e=ae-a.ref_e+b.span_e;
+    s.span_l=al-a.ref_l+b.span_l;
+    s.earliness+=b.earliness;
+    s.lateness+=b.lateness;
+    s.early+=b.early;
+    s.late+=b.late;
+    s.minearly=min(s.minearly, b.minearly);
+    s.minlate=min(s.minlate, b.minlate);
+    s.slack_e=min(s.slack_e, b.slack_e);
+    s.slack_l=min(s.slack_l, b.slack_l);
+    s.exact=a.exact && b.exact;
+    return s;
+}
+
+void TimingSummary::shift(long de, long dl) {
+    if (de>minearly || -de>slack_e || dl>slack_l || -dl>minlate)
+        exact=false;
+    ref_e+=de;
+    ref_l+=dl;
+    // later arrivals: less earliness, more lateness
+    earliness=max(earliness-double(early)*de, 0.0);
+    lateness=max(lateness+double(late)*dl, 0.0);
+    if (minearly!=inf)
+        minearly-=de;
+    if (slack_e!=inf)
+        slack_e+=de;
+    if (minlate!=inf)
+        minlate+=dl;
+    if (slack_l!=inf)
+        slack_l-=dl;
+}
+
+// the station has no service time nor time window
+TimingSummary TimingSummary::stop(const DenseRoute& dr, size_t s, long ae,
+        long al) {
+    TimingSummary sum{s, s, 0, ae, al, 0, 0, 0, 0, 0, 0, inf, inf, inf, inf,
+            true};
+    if (s==dr.station())
+        return sum;
+    sum.span_e=dr.earlyServiceTime(s);
+    sum.span_l=dr.lateServiceTime(s);
+    if (dr.hasTW(s)) {
+        const long e=dr.startTW(s)-ae, l=al-dr.endTW(s);
+        if (e>0) {
+            sum.earliness=e;
+            sum.early=1;
+            sum.minearly=e;
+        } else {
+            sum.slack_e=-e;
+        }
+        if (l>0) {
+            sum.lateness=l;
+            sum.late=1;
+            sum.minlate=l;
+        } else {
+            sum.slack_l=-l;
+        }
+    }
+    return sum;
+}
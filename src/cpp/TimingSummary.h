@@ -0,0 +1,36 @@
+#ifndef timingsummary_h
+#define timingsummary_h
+
+#include <cstddef>
+
+class DenseRoute;
+// timing of consecutive stops visited without waiting (see TimingEvaluator)
+// from a reference arrival at the first stop, as in Vidal et al.'s segment
+// summaries: two summaries are concatenated in O(1) by shifting the second one
+// in time; earliness and lateness stay exact unless a shifted stop changes
+// between early/late and on time, then 'exact' is cleared and they are
+// extrapolated linearly (used by the timing search of LocalSearch)
+class TimingSummary {
+    public:
+        size_t first, last;         // stops
+        double duration;            // travel time
+        long ref_e, ref_l;          // arrival at first
+        long span_e, span_l;        // up to the departure from last
+        double earliness, lateness;
+        int early, late;            // early/late stops
+        long minearly, minlate;     // smallest earliness/lateness
+        long slack_e, slack_l;      // smallest margin to early/late
+        bool exact;
+        void shift(long de, long dl);
+        // stop s visited right after a (exact)
+        static TimingSummary after(const DenseRoute& dr, const TimingSummary& a,
+                size_t s);
+        // b is shifted to start right after a
+        static TimingSummary concat(const DenseRoute& dr,
+                const TimingSummary& a, TimingSummary b);
+        // stop s alone, arriving at ae (early) and al (late)
+        static TimingSummary stop(const DenseRoute& dr, size_t s, long ae,
+                long al);
+};
+
+#endif
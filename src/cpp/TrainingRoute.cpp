@@ -1,16 +1,23 @@
 #include <algorithm>
-#include <deque>
 #include <iostream>
 #include "TrainingRoute.h"
 
 using namespace std;
 
-// TODO: refactor code duplicated in Sequence::score
 double TrainingRoute::computeScore(const Sequence& prop) const {
-    deque<string> act(seq.stops().begin()+1, seq.stops().end());  // no station
-    deque<string> prp(prop.stops().begin()+1, prop.stops().end());
-    auto normtts=ttimes.normalize();
-    return seq.deviation(prop)*Sequence::erpPerEdit(act, prp, normtts, 1000);
+    return Sequence::score(ttimes.normalize(), prop, seq);
+}
+
+vector<pair<double, bool>> TrainingRoute::computeScores(
+        const vector<Sequence>& props, double cutoff) const {
+    const auto normtts=ttimes.normalize();
+    vector<pair<double, bool>> scores;
+    for (const auto& prop : props) {
+        scores.push_back(Sequence::score(normtts, prop, seq, cutoff));
+        if (!scores.back().second && scores.back().first<cutoff)
+            cutoff=scores.back().first;
+    }
+    return scores;
 }
 
 bool TrainingRoute::setScore(const string& score) {
@@ -1,8 +1,11 @@
 #ifndef trainingroute_h
 #define trainingroute_h
 
+#include <limits>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include "Route.h"
 #include "Stop.h"
 #include "TestRoute.h"
@@ -12,6 +15,13 @@ class TrainingRoute : public Route {
         enum class Score {high, medium, low};
         TrainingRoute(std::string id) : Route(std::move(id)) {}
         double computeScore(const Sequence& prop) const;
+        // scores of many candidates: a candidate is only scored exactly if it
+        // can be below cutoff and below the best score so far, otherwise a
+        // lower bound is given (second=true); the best score is exact if it
+        // is below the initial cutoff
+        std::vector<std::pair<double, bool>> computeScores(
+                const std::vector<Sequence>& props,
+                double cutoff=std::numeric_limits<double>::max()) const;
         Score score() const {return score_;}
         void setCostInvalid(double c) {costinvalid=c;}
         bool setScore(const std::string& score);
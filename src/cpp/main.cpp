@@ -5,24 +5,37 @@
 #include "DatasetBuilder.h"
 #include "Learner.h"
 #include "Model.h"
+#include "Random.h"
+#include "Scorer.h"
 #include "SolutionInspector.h"
 #include "Tester.h"
 
 using namespace std;
 
 int main(int argc, char* argv[]) {
+    // --seed=N (anywhere) makes runs reproducible; it is removed from argv
+    bool seeded=false;
+    for (int i=1; i<argc; ++i)
+        if (string(argv[i]).compare(0, 7, "--seed=")==0) {
+            Random::setSeed(stoull(string(argv[i]).substr(7)));
+            seeded=true;
+            for (int j=i--; j+1<argc; ++j)
+                argv[j]=argv[j+1];
+            argc--;
+        }
     if (argc<2) {
-        cerr<<"usage: "<<argv[0]<<" <mode>"<<endl;
+        cerr<<"usage: "<<argv[0]<<" <mode> [--seed=N]"<<endl;
         cerr<<"where <mode> ="<<endl;
         cerr<<"\t0  build model"<<endl;
         cerr<<"\t1  apply model"<<endl;
         cerr<<"\t2  build development dataset"<<endl;
         cerr<<"\t3  inspect solution"<<endl;
         cerr<<"\t4  modify current model"<<endl;
+        cerr<<"\t5  score solution"<<endl;
         return EXIT_FAILURE;
     }
     int mode=stoi(argv[1]);
-    if (mode<0 || mode>4) {
+    if (mode<0 || mode>5) {
         cerr<<"invalid mode"<<endl;
         return EXIT_FAILURE;
     }
@@ -33,6 +46,9 @@ int main(int argc, char* argv[]) {
     const string path_mso="data/model_score_outputs/";
     const string modelfile="data/model_build_outputs/model.data";
     const string propseqs="data/model_apply_outputs/proposed_sequences.json";
+    if (mode<=2)
+        cout<<argv[0]<<": random seed "<<Random::seed()
+                <<(seeded?"":" (use --seed to reproduce)")<<endl;
     if (mode==0) {
         cout<<argv[0]<<": building model ..."<<endl;
         Learner l(path_mbi+"actual_sequences.json",
@@ -92,6 +108,20 @@ int main(int argc, char* argv[]) {
             si.inspectCSV();
         else
             si.inspect();
+    } else if (mode==5) {
+        if (argc!=4) {
+            cerr<<"usage: "<<argv[0]<<" 5 <propseqs> <scores>"<<endl;
+            cerr<<"where"<<endl;
+            cerr<<"    <propseqs>  JSON file: proposed sequences"<<endl;
+            cerr<<"    <scores>    JSON file: scores (output)"<<endl;
+            return EXIT_FAILURE;
+        }
+        cout<<argv[0]<<": scoring solution ..."<<endl;
+        Scorer sc(path_mai+"new_travel_times.json", argv[2],
+                path_msi+"new_actual_sequences.json",
+                path_msi+"new_invalid_sequence_scores.json");
+        sc.score();
+        sc.saveScores(argv[3]);
     } else {
         Model model;
         ifstream is(modelfile);